@@ -17,7 +17,7 @@
 using namespace corryvreckan;
 
 ClusterLoaderVMM3a::ClusterLoaderVMM3a(Configuration& config, std::shared_ptr<Detector> detector)
-    : Module(config, detector), m_detector(detector) {
+    : Module(config, detector), m_detector(detector), async_input(config_) {
 
       m_inputFile = config_.get<std::string>("file_input");
       LOG(DEBUG) << "Input file name: " << m_inputFile;
@@ -25,12 +25,46 @@ ClusterLoaderVMM3a::ClusterLoaderVMM3a(Configuration& config, std::shared_ptr<De
 			config_.setDefault<std::string>("pos_input_type", "pos");
 			pos_input_type_ = config_.get<std::string>("pos_input_type"); 
 
+			config_.setDefault<bool>("object_pool", false);
+			pixel_factory = ObjectFactory<Pixel>(config_.get<bool>("object_pool"));
+			cluster_factory = ObjectFactory<Cluster>(config_.get<bool>("object_pool"));
+
+			config_.setDefault<bool>("make_clusters", false);
+			m_makeClusters = config_.get<bool>("make_clusters");
+			m_detectorName = m_detector->getName();
+
+			config_.setDefault<int>("trace_sample_interval", 1000);
+			hit_trace = HotPathTracer(config_.get<int>("trace_sample_interval"));
+
 			}
 
 void ClusterLoaderVMM3a::initialize() {
 		
     LOG(DEBUG) << "Initialize ClusterLoaderVMM3a for " << m_detector->getName();
 
+		// Detector ID in the clusters_detector TTree, from the channel_map or the GEMXY<n> names
+		detectorID = ChannelMap(config_, 1).get(m_detector->getName()).det_id;
+		m_entry = 0;
+
+		// pos0 is the X and pos1 the Y strip position. The Pixels only hold whole strips, the calibration would be cut
+		// off with the fraction of the strip
+		if (m_makeClusters){
+			strip_calibration = StripCalibration(config_, static_cast<int>(m_detector->nPixels().X()), static_cast<int>(m_detector->nPixels().Y()));
+		}
+		else {
+			StripCalibration::reject(config_, "strip calibration needs make_clusters, Pixels only hold whole strips");
+		}
+		geometry = DetectorGeometryCache(m_detector);
+
+		// The tree is converted once into the column cache, the runs after it only map the file
+		if (config_.has("column_cache")){
+			m_useColumnCache = true;
+			column_cache.open(m_inputFile, config_.getPath("column_cache"));
+			number_of_entries = static_cast<Long64_t>(column_cache.size());
+			return;
+		}
+
+    prepareAsyncInput(async_input);
     data_file = TFile::Open(m_inputFile.c_str());
     if (!data_file || data_file->IsZombie()){
       LOG(DEBUG) << "Failed to open the data file: " << m_inputFile;
@@ -44,6 +78,8 @@ void ClusterLoaderVMM3a::initialize() {
     }
 
 
+    configureAsyncInput(data_tree, async_input);
+
     number_of_entries = data_tree->GetEntries();
     LOG(DEBUG) << "Number of entries in data_tree " << number_of_entries;
 
@@ -67,90 +103,188 @@ void ClusterLoaderVMM3a::initialize() {
 			pos1 = new TTreeReaderValue<double>(*reader, "pos1");
 		}
 
-		// Initialise member variables
-    m_entry = 0;
+		// Reading time0 once, the end of each event window is then found with a binary search
+		time_index = TimeIndex(data_tree, "time0");
+		if (!time_index.isSorted()){
+			LOG(WARNING) << "Clusters in " << m_inputFile << " are not sorted in time0, event windows are searched linearly";
+		}
 }
 
 StatusCode ClusterLoaderVMM3a::run(const std::shared_ptr<Clipboard>& clipboard) {
-    reader->SetLocalEntry(m_entry);
 
     auto event = clipboard->getEvent();
 
+		// End the run if all entries read
+    if (m_entry >= number_of_entries){return StatusCode::EndRun;}
+
     // Make a container for pixels
     PixelVector pixelContainer;
 
+    if (m_useColumnCache){
+      return ReadColumnCache(event->duration(), pixelContainer, clipboard);
+    }
 
-    // Using the first hit as reference, reset the time at the start of every event
-    if (current_first==-1) current_first=**time0;
 
-    while (true){
+    // Using the first hit as reference for the event time window. Data has to be in the
+    // event timewindow, using event->duration(), the window ends at the first entry after it
+    Long64_t last_entry;
+    {
+      auto stall = input_stall.measure();
+      last_entry = time_index.findWindowEnd(m_entry, time_index.getTime(m_entry), event->duration());
+    }
+    LOG(DEBUG) << "Event window: entries " << m_entry << " to " << last_entry;
 
-      // Current time is the reference to the first entry of the event defined by the metronome
-      current_time = **time0-current_first;
+    // Check if there are any entries left after the window, if not, end the run
+    if (last_entry >= number_of_entries){
+      LOG(DEBUG) << "Run ended, all entries read";
+      m_entry = number_of_entries;
+      return StatusCode::EndRun;
+    }
 
-      LOG(DEBUG) << std::fixed << std::setprecision(10) << "(Entry " << m_entry << "):  current_time  =  " << current_time << ",  **time  =  " << **time0;
+    for (; m_entry < last_entry; m_entry++){
 
+      {
+        auto stall = input_stall.measure();
+        reader->SetLocalEntry(m_entry);
+      }
 
-      // Data has to be in the event timewindow, using event->duration()
-      // If current_time > event->duration(), breaking the event
+      if (detectorID==static_cast<int>(**det) && **pos0 != 0 && **pos1 != 0){
+				
+				window_pos0.push_back(**pos0);
+				window_pos1.push_back(**pos1);
+				window_charge.push_back(**adc0+**adc1);
+				window_time.push_back(**time0);
+				
+        HOT_PATH_TRACE(hit_trace, "pixel", "det", **det, "pos0", **pos0, "pos1", **pos1, "charge", **adc0+**adc1, "time0", **time0);
+      }
+      else {HOT_PATH_TRACE(hit_trace, "entry of other detector", "det", **det);}
 
-      if (current_time > event->duration()){
-        LOG(DEBUG) << "============== Data outside event, breaking =============="; break;
-        }
+    } // for (entries in window)
 
+    // Add data to clipboard, for each detector
+    StoreWindow(pixelContainer, clipboard);
+    m_eventNumber++;
 
-      // Change the detector names to match the corryvreckan geometry file! 
-      if(strcmp(m_detector->getName().c_str(), "GEMXY1")==0) detectorID=1;
-      if(strcmp(m_detector->getName().c_str(), "GEMXY2")==0) detectorID=2;
-      if(strcmp(m_detector->getName().c_str(), "GEMXY3")==0) detectorID=3;
-      if(strcmp(m_detector->getName().c_str(), "GEMXY4")==0) detectorID=4;
 
+    // Return value telling analysis to keep running
+    return StatusCode::Success;
+}
 
-      // Pixel args: 
-      //  for x-plane: [detector_name, pos0 (col), pos1 (row), raw (set to 1 if not known), adc0+adc1 (charge), time0]
+StatusCode ClusterLoaderVMM3a::ReadColumnCache(double duration, PixelVector& pixelContainer, const std::shared_ptr<Clipboard>& clipboard) {
 
-      if (detectorID==static_cast<int>(**det) && **pos0 != 0 && **pos1 != 0){
-				
-				auto pixel = std::make_shared<Pixel>(m_detector->getName(), **pos0, **pos1, 1, **adc0+**adc1, **time0);
-				
-        LOG(DEBUG) << "Cluster in Detector: " << m_detector->getName();
-        LOG(DEBUG) << "Making Pixel =  det  :  col(pos0)  : row(pos1)  :  charge(adc0+adc1)  :  time0";
-        LOG(DEBUG) << std::fixed << std::setprecision(15) <<  "      " << static_cast<int>(**det) << "      " << **pos0 << "      " << **pos1 << "      " << **adc0+**adc1 << "      " << **time0;
-				pixelContainer.push_back(pixel);
+    // The clusters are sorted in time0, the window ends at the first cluster after it
+    auto entry = static_cast<size_t>(m_entry);
+    auto last_entry = column_cache.findWindowEnd(entry, column_cache.time0(entry), duration);
+
+    // Check if there are any entries left after the window, if not, end the run
+    if (last_entry >= column_cache.size()){
+      LOG(DEBUG) << "Run ended, all entries read";
+      m_entry = number_of_entries;
+      return StatusCode::EndRun;
+    }
+
+    auto charge2 = (pos_input_type_ == "charge2");
+    for (; entry < last_entry; entry++){
+      auto pos0 = column_cache.pos0(entry, charge2);
+      auto pos1 = column_cache.pos1(entry, charge2);
+      if (detectorID==static_cast<int>(column_cache.det(entry)) && pos0 != 0 && pos1 != 0){
+        auto charge = column_cache.adc0(entry) + column_cache.adc1(entry);
+        HOT_PATH_TRACE(hit_trace, "pixel", "det", column_cache.det(entry), "pos0", pos0, "pos1", pos1, "charge", charge, "time0", column_cache.time0(entry));
+        window_pos0.push_back(pos0);
+        window_pos1.push_back(pos1);
+        window_charge.push_back(charge);
+        window_time.push_back(column_cache.time0(entry));
       }
-      else {LOG(DEBUG) << "  No clusters in " << m_detector->getName();}
+      else {HOT_PATH_TRACE(hit_trace, "entry of other detector", "det", column_cache.det(entry));}
+    }
+    m_entry = static_cast<Long64_t>(last_entry);
 
-      // Next entry
-      m_entry++;
+    StoreWindow(pixelContainer, clipboard);
+    m_eventNumber++;
+    return StatusCode::Success;
+}
 
-      // Check again if there are any entries left, if not, end the run
-      if (m_entry > number_of_entries){
-        LOG(DEBUG) << "Run ended, all entries read";
-        break;
-        }
-			// Otherwise read in the next entry as the event hasn't ended
-      else {reader->SetLocalEntry(m_entry);}
-    } // while(true)
+void ClusterLoaderVMM3a::StoreWindow(PixelVector& pixelContainer, const std::shared_ptr<Clipboard>& clipboard) {
 
-		// End the run if all entries read
-    if (m_entry > number_of_entries){return StatusCode::EndRun;}
+    if (m_makeClusters){
+      ClusterVector clusterContainer;
+      MakeClusters(clusterContainer);
+      clipboard->putData(clusterContainer, m_detector->getName());
+    }
+    else {
+      // Pixel args: pos0 (col), pos1 (row), raw (set to 1 if not known), adc0+adc1 (charge), time0
+      for (size_t i = 0; i < window_time.size(); i++){
+        pixelContainer.push_back(pixel_factory.make(m_detectorName, window_pos0[i], window_pos1[i], 1, window_charge[i], window_time[i]));
+      }
+      clipboard->putData(pixelContainer, m_detector->getName());
+    }
 
+    window_pos0.clear();
+    window_pos1.clear();
+    window_charge.clear();
+    window_time.clear();
+}
 
+void ClusterLoaderVMM3a::MakeClusters(ClusterVector& clusterContainer) {
 
-    // Reset the current event reference
-    current_first = -1;
+    // Both planes of the whole window are calibrated at once
+    if (strip_calibration.enabled()){
+      strip_calibration.apply(0, window_pos0, calibrated_pos0, alive0);
+      strip_calibration.apply(1, window_pos1, calibrated_pos1, alive1);
+    }
+    else {
+      calibrated_pos0 = window_pos0;
+      calibrated_pos1 = window_pos1;
+      alive0.assign(window_pos0.size(), 1);
+      alive1.assign(window_pos1.size(), 1);
+    }
 
-    // Add data to clipboard, for each detector
-    clipboard->putData(pixelContainer, m_detector->getName());
+    // pos0 is the column and pos1 the row, the positions of all clusters are transformed at once
+    local_x.clear();
+    local_y.clear();
+    for (size_t i = 0; i < calibrated_pos0.size(); i++){
+      auto positionLocal = geometry.getLocalPosition(calibrated_pos0[i], calibrated_pos1[i]);
+      local_x.push_back(positionLocal.x());
+      local_y.push_back(positionLocal.y());
+    }
+    geometry.localToGlobal(local_x, local_y, global_x, global_y, global_z);
 
+    for (size_t i = 0; i < window_time.size(); i++){
+      if (!alive0[i] || !alive1[i]){
+        clusters_on_dead_strips++;
+        continue;
+      }
 
-    // Return value telling analysis to keep running
-    return StatusCode::Success;
+      auto cluster = cluster_factory.make();
+      cluster->setColumn(calibrated_pos0[i]);
+      cluster->setRow(calibrated_pos1[i]);
+      cluster->setCharge(window_charge[i]);
+      cluster->setTimestamp(window_time[i]);
+      cluster->setDetectorID(m_detectorName);
+      cluster->setSplit(false);
+
+      cluster->setClusterCentreLocal(ROOT::Math::XYZPoint(local_x[i], local_y[i], 0));
+      cluster->setClusterCentre(ROOT::Math::XYZPoint(global_x[i], global_y[i], global_z[i]));
+      cluster->setError(geometry.getSpatialResolution(calibrated_pos0[i], calibrated_pos1[i]));
+      cluster->setErrorMatrixGlobal(geometry.getSpatialResolutionMatrixGlobal(calibrated_pos0[i], calibrated_pos1[i]));
+      clusterContainer.push_back(cluster);
+    }
 }
 
 void ClusterLoaderVMM3a::finalize(const std::shared_ptr<ReadonlyClipboard>&) {
 
   // Event = many entries, m_entry = cluster number, in our case
   LOG(DEBUG) << "Analysed " << m_entry << " entries";
+  input_stall.report(m_detector->getName(), m_eventNumber);
+  if (strip_calibration.enabled()){
+    LOG(INFO) << m_detector->getName() << ": " << clusters_on_dead_strips << " clusters on dead strips dropped";
+  }
+  if (m_makeClusters){
+    cluster_factory.report(m_detector->getName(), m_eventNumber);
+  }
+  else {
+    pixel_factory.report(m_detector->getName(), m_eventNumber);
+  }
+  hit_trace.report(m_detector->getName());
 
 	}
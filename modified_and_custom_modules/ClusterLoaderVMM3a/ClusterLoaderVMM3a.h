@@ -25,6 +25,14 @@
 #include "objects/Cluster.hpp"
 #include "objects/Pixel.hpp"
 #include "objects/Track.hpp"
+#include "tools/AsyncInput.h"
+#include "tools/ChannelMap.h"
+#include "tools/DetectorGeometryCache.h"
+#include "tools/HotPathTrace.h"
+#include "tools/ObjectPool.h"
+#include "tools/StripCalibration.h"
+#include "tools/TimeIndex.h"
+#include "tools/VMM3aColumnCache.h"
 
 namespace corryvreckan {
     /** @ingroup Modules
@@ -58,14 +66,23 @@ namespace corryvreckan {
         void finalize(const std::shared_ptr<ReadonlyClipboard>& clipboard) override;
 
     private:
+        // Pixels of the next event window from the column cache
+        StatusCode ReadColumnCache(double duration, PixelVector& pixelContainer, const std::shared_ptr<Clipboard>& clipboard);
+
+        // Puts the clusters of this detector collected from the event window on the clipboard, as Pixels or Clusters
+        void StoreWindow(PixelVector& pixelContainer, const std::shared_ptr<Clipboard>& clipboard);
+
+        // Clusters of the event window at their calibrated positions, only with make_clusters
+        void MakeClusters(ClusterVector& clusterContainer);
+
         std::shared_ptr<Detector> m_detector;
 
         Long64_t m_entry;
         Long64_t number_of_entries;
         int detectorID;
-        std::string strip_axis="";
-        double current_first = -1;
-        double current_time = -1;
+
+        // Index of time0 to find the end of the event windows
+        TimeIndex time_index;
 
 
         TFile* data_file;
@@ -82,10 +99,41 @@ namespace corryvreckan {
         TTreeReaderValue<uint16_t> *size0;
         TTreeReaderValue<uint16_t> *size1;
 
+				// Time sorted columns of the clusters_detector tree, used instead of the tree if column_cache is set
+				bool m_useColumnCache{false};
+				VMM3aColumnCache column_cache;
+
 				// Input parameters
 				std::string m_inputFile;
+				std::string m_detectorName;
 				std::string pos_input_type_;
 
+				// Read-ahead settings and time spent waiting for the input
+				AsyncInputSettings async_input;
+				InputStallTimer input_stall;
+				long m_eventNumber{0};
+
+				// Creates the Pixels, from a pool if object_pool is set
+				ObjectFactory<Pixel> pixel_factory;
+
+				// Clusters instead of Pixels, so the positions keep their fraction of a strip
+				bool m_makeClusters;
+				ObjectFactory<Cluster> cluster_factory;
+				DetectorGeometryCache geometry;
+				std::vector<double> local_x, local_y;
+				std::vector<double> global_x, global_y, global_z;
+
+				// Calibration of pos0 and pos1, and the clusters of this detector in the current event window
+				StripCalibration strip_calibration;
+				std::vector<double> window_pos0, window_pos1, window_time;
+				std::vector<int> window_charge;
+				std::vector<double> calibrated_pos0, calibrated_pos1;
+				std::vector<unsigned char> alive0, alive1;
+				long clusters_on_dead_strips{0};
+
+				// Per-hit tracing, only compiled with the CORRYVRECKAN_HOT_PATH_TRACE build option
+				HotPathTracer hit_trace;
+
     };
 
 } // namespace corryvreckan
@@ -12,6 +12,10 @@
 #include "ClusteringGeneric.h"
 #include "objects/Pixel.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 #include <TBranch.h>
 #include <TKey.h>
 #include <TObjArray.h>
@@ -34,7 +38,7 @@
 using namespace corryvreckan;
 
 ClusteringGeneric::ClusteringGeneric(Configuration& config, std::shared_ptr<Detector> detector)
-  : Module(config, detector), m_detector(detector) {
+  : Module(config, detector), m_detector(detector), async_input(config_) {
 
     config_.setAlias("spatial_cut_abs", "spatial_cut", true);
     config_.setDefault<std::string>("file_input", "Ttree.root");
@@ -42,6 +46,33 @@ ClusteringGeneric::ClusteringGeneric(Configuration& config, std::shared_ptr<Dete
     spatial_cut_ = corryvreckan::calculate_cut<XYVector>("spatial_cut", config_, m_detector);
 		noise_cut = config_.get<double>("noise_cut");
 
+		// The DUT and the diamond are not named after the GEMs, give their IDs in the TCluster TTree
+		config_.setDefaultArray<std::string>("channel_map", {"dut:3", "diamond:4"});
+
+		// X and Y clusters of one particle share the avalanche charge, pairs with very different charges are ghosts
+		config_.setDefaultArray<double>("pairing_charge_ratio", {0.5, 2.0});
+		config_.setDefault<size_t>("max_pairs_per_event", 0);
+		config_.setDefault<bool>("pairing_fallback", true);
+
+		auto charge_ratio = config_.getArray<double>("pairing_charge_ratio");
+		if(charge_ratio.size() != 2 || charge_ratio[0] < 0 || charge_ratio[0] > charge_ratio[1]) {
+			throw InvalidValueError(config_, "pairing_charge_ratio", "needs a lower and an upper Y/X charge ratio");
+		}
+		charge_ratio_min = charge_ratio[0];
+		charge_ratio_max = charge_ratio[1];
+
+		// Local position range of the pairs, x_min, x_max, y_min and y_max
+		if(config_.has("pairing_position_range")) {
+			position_range = config_.getArray<double>("pairing_position_range");
+			if(position_range.size() != 4 || position_range[0] > position_range[1] || position_range[2] > position_range[3]) {
+				throw InvalidValueError(config_, "pairing_position_range", "needs x_min, x_max, y_min and y_max");
+			}
+			use_position_range = true;
+		}
+
+		max_pairs = config_.get<size_t>("max_pairs_per_event");
+		pairing_fallback = config_.get<bool>("pairing_fallback");
+
   }
 
 ClusteringGeneric::~ClusteringGeneric(){
@@ -114,20 +145,25 @@ void ClusteringGeneric::initialize() {
   LOG(DEBUG) << "Pitch size X: " << m_detector->getPitch().X();
   LOG(DEBUG) << "Pitch size Y: " << m_detector->getPitch().Y();
 
+  // Detector ID in the TCluster TTree, from the channel_map or the GEMXY<n> names starting from 0
+  auto channel = ChannelMap(config_, 0).find(m_detector->getName());
+  if(!channel) {
+    LOG(WARNING) << "Detector " << m_detector->getName() << " not in the channel_map, no clusters will be read for it";
+  }
+  detectorID = channel ? channel->det_id : -1;
+
   // Initialise member variables
   m_eventNumber = 0;
 	number_of_misses=0;
 	LOG(DEBUG) << "INPUT_FILE:: " << fileInput.c_str();
 	
-  TFile *myFile = TFile::Open(fileInput.c_str());
-  reader = new TTreeReader("TCluster", myFile);
-
-  evtID = new TTreeReaderArray<int>(*reader, "evtID");
-  detID = new TTreeReaderArray<int>(*reader, "detID");
-  planeID = new TTreeReaderArray<int>(*reader, "planeID");
-  clustPos = new TTreeReaderArray<float>(*reader, "clustPos");
-  clustADCs = new TTreeReaderArray<float>(*reader, "clustADCs");
-	//clustSize = new TTreeReaderArray<int>(*reader, "clustSize");
+  geometry = DetectorGeometryCache(m_detector);
+  LOG(DEBUG) << "Spatial resolution " << (geometry.constantResolution() ? "constant" : "position dependent");
+
+  cluster_reader = TClusterDemultiplexer::getInstance(fileInput, async_input);
+  if(detectorID >= 0) {
+    cluster_reader->registerDetector(detectorID);
+  }
 }
 
 StatusCode ClusteringGeneric::run(const std::shared_ptr<Clipboard>& clipboard) {
@@ -139,13 +175,12 @@ StatusCode ClusteringGeneric::run(const std::shared_ptr<Clipboard>& clipboard) {
 	temp_cluster_Xcharge_container.clear();
 	temp_cluster_Ycharge_container.clear();
 
-  reader->SetLocalEntry(m_eventNumber);
+  cluster_reader->loadEvent(m_eventNumber);
 
   LOG(DEBUG) << "evt Corryvreckan___: " << m_eventNumber;
 
   // Make the cluster container and the maps for clustering
   ClusterVector deviceClusters;
-  auto cluster = std::make_shared<Cluster>();
 
 	// Get the detector nam. Probably DAQ/Config file related.e
 	std::string detectorName = m_detector->getName();
@@ -153,45 +188,40 @@ StatusCode ClusteringGeneric::run(const std::shared_ptr<Clipboard>& clipboard) {
 	LOG(DEBUG) << "Detector name: " << detectorName << "  and type: " << detectorType;
 	LOG(DEBUG) << "File Input: " << fileInput;
 	
-	// Excluding DUT detector, since no position
-	int detectorID=-1;
-	if(strcmp(detectorName.c_str(), "GEMXY1")==0) detectorID=0;
-	if(strcmp(detectorName.c_str(), "GEMXY2")==0) detectorID=1;
-	if(strcmp(detectorName.c_str(), "GEMXY3")==0) detectorID=2;
-	if(strcmp(detectorName.c_str(), "dut")==0) detectorID=3;
-	if(strcmp(detectorName.c_str(), "diamond")==0) detectorID=4;
-
 
 	// Considering if one hit point (x,y) per telescope
-  if(detID->GetSize()==6){
+  if(cluster_reader->getEntrySize()==6){
 		number_of_clusters++;
-		for (size_t i = 0; i < detID->GetSize(); i++) {
 
-			if(detID->At(i)!=detectorID) continue;
-			
-			if(planeID->At(i)==0){
-				if (clustADCs->At(i)>noise_cut){
-					temp_cluster_Xpos_container.push_back(clustPos->At(i));
-					temp_cluster_Xcharge_container.push_back(clustADCs->At(i));
-				}
-				
+		// Only the clusters of this detector, bucketed by plane when the entry was read
+		for (const auto& clust : cluster_reader->getClusters(detectorID, 0)) {
+			if (clust.adc>noise_cut){
+				temp_cluster_Xpos_container.push_back(clust.pos);
+				temp_cluster_Xcharge_container.push_back(clust.adc);
+			}
+		}
+		for (const auto& clust : cluster_reader->getClusters(detectorID, 1)) {
+			if (clust.adc>noise_cut){
+				temp_cluster_Ypos_container.push_back(clust.pos);
+				temp_cluster_Ycharge_container.push_back(clust.adc);
 			}
-			if(planeID->At(i)==1){
-				if (clustADCs->At(i)>noise_cut){
-					temp_cluster_Ypos_container.push_back(clustPos->At(i));
-					temp_cluster_Ycharge_container.push_back(clustADCs->At(i));
-					}
-				}
-			} // for (detID size)
+		}
 	
 
-		// Initialize clustering variables
-		int cluster_pair_idx_y = 0;
-		double x_y_ratio = 999;
+		PairClusters();
+
+		// All positions of the event are transformed at once
+		local_x.clear();
+		local_y.clear();
+		for (const auto& pair : cluster_pairs){
+			local_x.push_back(temp_cluster_Xpos_container[pair.first]);
+			local_y.push_back(temp_cluster_Ypos_container[pair.second]);
+		}
+		geometry.localToGlobal(local_x, local_y, global_x, global_y, global_z);
+
+		for (size_t i=0; i<cluster_pairs.size(); i++){
+					auto j = cluster_pairs[i].first, k = cluster_pairs[i].second;
 
-		for (size_t j=0; j<temp_cluster_Xpos_container.size(); j++){	
-				for (size_t k=0; k<temp_cluster_Ypos_container.size(); k++){
-					
 					LOG(DEBUG) << "POS ratio X" << j << "/Y" << k << " =" << temp_cluster_Xpos_container[j] << "/" << temp_cluster_Ypos_container[k] << 
 					" = " << temp_cluster_Xpos_container[j]/temp_cluster_Ypos_container[k] << 
 					",  ADC ratio X" << j << "/Y" << k << " =" << temp_cluster_Xcharge_container[j] << "/" << temp_cluster_Ycharge_container[k] << 
@@ -201,16 +231,16 @@ StatusCode ClusteringGeneric::run(const std::shared_ptr<Clipboard>& clipboard) {
 					x = temp_cluster_Xpos_container[j], y = temp_cluster_Ypos_container[k]; 
 					charge_x = temp_cluster_Xcharge_container[j], charge_y = temp_cluster_Ycharge_container[k]; 
 
-					// Create object with local cluster position
+					// Local cluster position and the global one with the alignment
 					auto positionLocal = ROOT::Math::XYZPoint(x, y, 0);
+					auto positionGlobal = ROOT::Math::XYZPoint(global_x[i], global_y[i], global_z[i]);
 
-					// Calculate6global cluster position
-					auto positionGlobal = m_detector->localToGlobal(positionLocal);
-
-					cluster->setTimestamp(evtID->At(0));
+					// Every pair is its own cluster
+					auto cluster = std::make_shared<Cluster>();
+					cluster->setTimestamp(cluster_reader->getEventID());
 					cluster->setCharge(charge_x+charge_y);
-					cluster->setError(m_detector->getSpatialResolution(x, y));
-					cluster->setErrorMatrixGlobal(m_detector->getSpatialResolutionMatrixGlobal(x, y));
+					cluster->setError(geometry.getSpatialResolution(x, y));
+					cluster->setErrorMatrixGlobal(geometry.getSpatialResolutionMatrixGlobal(x, y));
 					cluster->setDetectorID(detectorName);
 					cluster->setClusterCentre(positionGlobal);
 					cluster->setClusterCentreLocal(positionLocal);
@@ -218,8 +248,7 @@ StatusCode ClusteringGeneric::run(const std::shared_ptr<Clipboard>& clipboard) {
 					
 					LOG(DEBUG) << "detID == " << detectorID << "; cluster[" << j << k << "]: (x,y) + charge: (" << cluster->global().x() << ", " << cluster->global().y() << ") + " << cluster->charge();
 					
-					} // for (size tempYpos)
-				} // for (size tempXpos)
+				} // for (cluster pairs)
 				
       } // if (detID size)>5	
 			else { number_of_misses++;}
@@ -237,12 +266,76 @@ StatusCode ClusteringGeneric::run(const std::shared_ptr<Clipboard>& clipboard) {
 	LOG(DEBUG) << std::endl;
 
   // Return value telling analysis to keep running
-  if(reader->GetEntries()==m_eventNumber) return StatusCode::EndRun;
+  if(cluster_reader->getEntries()==m_eventNumber) return StatusCode::EndRun;
   return StatusCode::Success;
 }
 
+void ClusteringGeneric::PairClusters() {
+	cluster_pairs.clear();
+	pair_candidates.clear();
+
+	const auto& x_charge = temp_cluster_Xcharge_container;
+	const auto& y_charge = temp_cluster_Ycharge_container;
+
+	// Distance from equal charge sharing, symmetric in X and Y
+	auto imbalance = [](double charge_x, double charge_y) {
+		return (charge_x > 0 && charge_y > 0) ? std::fabs(std::log(charge_y / charge_x)) : std::numeric_limits<double>::infinity();
+	};
+
+	// Y clusters in increasing charge, the compatible ones of an X cluster are then one contiguous range
+	y_by_charge.resize(y_charge.size());
+	for (size_t k = 0; k < y_by_charge.size(); k++) {
+		y_by_charge[k] = k;
+	}
+	std::sort(y_by_charge.begin(), y_by_charge.end(), [&](size_t a, size_t b) { return y_charge[a] < y_charge[b]; });
+
+	for (size_t j = 0; j < x_charge.size(); j++) {
+		auto x_pos = temp_cluster_Xpos_container[j];
+		if (use_position_range && (x_pos < position_range[0] || x_pos > position_range[1])) {
+			continue;
+		}
+
+		auto low = std::lower_bound(y_by_charge.begin(), y_by_charge.end(), charge_ratio_min * x_charge[j],
+			[&](size_t k, double charge) { return y_charge[k] < charge; });
+		auto high = std::upper_bound(low, y_by_charge.end(), charge_ratio_max * x_charge[j],
+			[&](double charge, size_t k) { return charge < y_charge[k]; });
+
+		for (auto it = low; it != high; it++) {
+			auto y_pos = temp_cluster_Ypos_container[*it];
+			if (use_position_range && (y_pos < position_range[2] || y_pos > position_range[3])) {
+				continue;
+			}
+			pair_candidates.push_back({imbalance(x_charge[j], y_charge[*it]), {j, *it}});
+		}
+	}
+
+	auto all_pairs = x_charge.size() * y_charge.size();
+	if (pair_candidates.empty() && all_pairs > 0 && pairing_fallback) {
+		number_of_fallbacks++;
+		for (size_t j = 0; j < x_charge.size(); j++) {
+			for (size_t k = 0; k < y_charge.size(); k++) {
+				pair_candidates.push_back({imbalance(x_charge[j], y_charge[k]), {j, k}});
+			}
+		}
+	}
+
+	// The budget keeps the best balanced pairs
+	if (max_pairs > 0 && pair_candidates.size() > max_pairs) {
+		std::partial_sort(pair_candidates.begin(), pair_candidates.begin() + static_cast<std::ptrdiff_t>(max_pairs), pair_candidates.end());
+		pair_candidates.resize(max_pairs);
+	}
+
+	for (const auto& candidate : pair_candidates) {
+		cluster_pairs.push_back(candidate.second);
+	}
+	number_of_pairs_rejected += static_cast<long>(all_pairs - cluster_pairs.size());
+}
+
 void ClusteringGeneric::finalize(const std::shared_ptr<ReadonlyClipboard>&) {
   LOG(DEBUG) << "Analysed " << m_eventNumber << " events";
 	LOG(DEBUG) << "number_of_misses: " << number_of_misses;
 	LOG(DEBUG) << "number_of_clusters: " << number_of_clusters;
+	LOG(INFO) << m_detector->getName() << ": " << number_of_pairs_rejected << " X-Y cluster pairs rejected by the pairing gates, "
+		<< number_of_fallbacks << " events paired without gates";
+	cluster_reader->reportInputTime();
 }
@@ -29,6 +29,11 @@
 
 #include "core/module/Module.hpp"
 #include "objects/Cluster.hpp"
+#include "tools/AsyncInput.h"
+#include "tools/ChannelMap.h"
+#include "tools/DetectorGeometryCache.h"
+
+#include "TClusterDemultiplexer.h"
 
 namespace corryvreckan {
   /** @ingroup Modules
@@ -75,16 +80,12 @@ namespace corryvreckan {
       std::shared_ptr<Detector> m_detector;
 
       int m_eventNumber;
+      int detectorID;
 			double noise_cut;
       std::string fileInput;
 
-      TTreeReader *reader;
-      TTreeReaderArray<int> *evtID;
-      TTreeReaderArray<int> *detID;
-      TTreeReaderArray<int> *planeID;
-      TTreeReaderArray<float> *clustPos;
-      TTreeReaderArray<float> *clustADCs; 
-      // TTreeReaderArray<int> *clustSize;
+      // TCluster reader shared with the other detectors reading the same file
+      std::shared_ptr<TClusterDemultiplexer> cluster_reader;
 
 			std::vector<float> temp_cluster_Xpos_container;
 			std::vector<float> temp_cluster_Ypos_container;
@@ -109,6 +110,37 @@ namespace corryvreckan {
 
 			ROOT::Math::XYVector spatial_cut_;
 
+			/**
+			 * @brief Select the X and Y cluster pairs of the event that become clusters
+			 *
+			 * Only pairs with a Y/X charge ratio inside pairing_charge_ratio and, if given, a position inside
+			 * pairing_position_range are kept, the pairs closest to equal charge first, up to max_pairs_per_event.
+			 * If no pair passes, the full product is used when pairing_fallback is set.
+			 */
+			void PairClusters();
+
+			// Pairing gates and budget
+			double charge_ratio_min, charge_ratio_max;
+			bool use_position_range{false};
+			std::vector<double> position_range;
+			size_t max_pairs;
+			bool pairing_fallback;
+
+			// Pairing workspace, indices of the X and Y clusters
+			std::vector<size_t> y_by_charge;
+			std::vector<std::pair<double, std::pair<size_t, size_t>>> pair_candidates;
+			std::vector<std::pair<size_t, size_t>> cluster_pairs;
+
+			// Transformations and resolution of the detector, built in initialize()
+			DetectorGeometryCache geometry;
+
+			// Local and global positions of the pairs of the event
+			std::vector<double> local_x, local_y;
+			std::vector<double> global_x, global_y, global_z;
+
+			long number_of_pairs_rejected=0;
+			long number_of_fallbacks=0;
+
 		
 			int number_of_misses=0;
 			int number_of_clusters=0;
@@ -116,6 +148,9 @@ namespace corryvreckan {
 			// Preclustering cluster plot
 			TH2F* rawClusters;
 
+			// Read-ahead settings, the time spent reading is measured and reported by the shared reader
+			AsyncInputSettings async_input;
+
 
   };
 
@@ -0,0 +1,154 @@
+/**
+ * @file
+ * @brief Implementation of the shared TCluster TTree reader of ClusteringGeneric
+ *
+ * @copyright Copyright (c) 2020 CERN and the Corryvreckan authors.
+ * This software is distributed under the terms of the MIT License, copied verbatim in the file "LICENSE.md".
+ * In applying this license, CERN does not waive the privileges and immunities granted to it by virtue of its status as an
+ * Intergovernmental Organization or submit itself to any jurisdiction.
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "TClusterDemultiplexer.h"
+
+#include "core/module/exceptions.h"
+#include "core/utils/log.h"
+
+using namespace corryvreckan;
+
+std::map<std::string, std::weak_ptr<TClusterDemultiplexer>> TClusterDemultiplexer::instances_;
+std::mutex TClusterDemultiplexer::instances_mutex_;
+
+std::shared_ptr<TClusterDemultiplexer> TClusterDemultiplexer::getInstance(const std::string& file_name,
+                                                                          const AsyncInputSettings& async_input) {
+    std::lock_guard<std::mutex> lock(instances_mutex_);
+
+    auto instance = instances_[file_name].lock();
+    if(!instance) {
+        instance = std::shared_ptr<TClusterDemultiplexer>(new TClusterDemultiplexer(file_name, async_input));
+        instances_[file_name] = instance;
+    }
+    return instance;
+}
+
+TClusterDemultiplexer::TClusterDemultiplexer(const std::string& file_name, const AsyncInputSettings& async_input)
+    : m_inputFile(file_name), m_bucketIndex(max_detectors * max_planes, -1) {
+
+    prepareAsyncInput(async_input);
+    data_file = TFile::Open(m_inputFile.c_str());
+    if(!data_file || data_file->IsZombie()) {
+        throw ModuleError("Error in opening TFile " + m_inputFile);
+    }
+
+    auto* data_tree = dynamic_cast<TTree*>(data_file->Get("TCluster"));
+    if(!data_tree) {
+        throw ModuleError("Failed to retrieve TTree 'TCluster'");
+    }
+    configureAsyncInput(data_tree, async_input);
+
+    number_of_entries = data_tree->GetEntries();
+    LOG(DEBUG) << "Number of entries in TCluster " << number_of_entries;
+
+    reader = new TTreeReader(data_tree);
+    evtID = new TTreeReaderArray<int>(*reader, "evtID");
+    detID = new TTreeReaderArray<int>(*reader, "detID");
+    planeID = new TTreeReaderArray<int>(*reader, "planeID");
+    clustPos = new TTreeReaderArray<float>(*reader, "clustPos");
+    clustADCs = new TTreeReaderArray<float>(*reader, "clustADCs");
+}
+
+TClusterDemultiplexer::~TClusterDemultiplexer() {
+    delete clustADCs;
+    delete clustPos;
+    delete planeID;
+    delete detID;
+    delete evtID;
+    delete reader;
+    delete data_file;
+}
+
+void TClusterDemultiplexer::registerDetector(int det_id) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if(det_id < 0 || det_id >= max_detectors) {
+        throw ModuleError("detID " + std::to_string(det_id) + " outside of the supported range 0-" +
+                          std::to_string(max_detectors - 1));
+    }
+
+    for(int plane_id = 0; plane_id < max_planes; plane_id++) {
+        auto& index = m_bucketIndex[bucketKey(det_id, plane_id)];
+        if(index < 0) {
+            index = static_cast<int>(m_buckets.size());
+            m_buckets.emplace_back();
+        }
+    }
+}
+
+void TClusterDemultiplexer::loadEvent(Long64_t entry) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Another detector instance already decoded this entry
+    if(entry == m_entry) {
+        return;
+    }
+    m_entry = entry;
+
+    for(auto& bucket : m_buckets) {
+        bucket.clear();
+    }
+    m_entrySize = 0;
+    m_eventID = -1;
+
+    {
+        // The arrays are read on first access, so they are all touched here
+        auto stall = input_time.measure();
+        m_entriesRead++;
+        if(reader->SetLocalEntry(entry) != TTreeReader::kEntryValid) {
+            LOG(WARNING) << "Failed to read entry " << entry << " of " << m_inputFile;
+            return;
+        }
+        for(auto array : {evtID, detID, planeID}) {
+            array->GetSize();
+        }
+        clustPos->GetSize();
+        clustADCs->GetSize();
+    }
+
+    m_entrySize = detID->GetSize();
+    if(m_entrySize > 0) {
+        m_eventID = evtID->At(0);
+    }
+
+    // Single pass over the entry, every cluster goes straight to the bucket of its plane
+    for(size_t i = 0; i < m_entrySize; i++) {
+        auto det_id = detID->At(i);
+        auto plane_id = planeID->At(i);
+        if(det_id < 0 || det_id >= max_detectors || plane_id < 0 || plane_id >= max_planes) {
+            continue;
+        }
+
+        auto index = m_bucketIndex[bucketKey(det_id, plane_id)];
+        if(index >= 0) {
+            m_buckets[static_cast<size_t>(index)].push_back({clustPos->At(i), clustADCs->At(i)});
+        }
+    }
+}
+
+void TClusterDemultiplexer::reportInputTime() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if(!m_inputReported) {
+        m_inputReported = true;
+        input_time.report(m_inputFile, m_entriesRead);
+    }
+}
+
+const std::vector<TClusterDemultiplexer::Cluster>& TClusterDemultiplexer::getClusters(int det_id, int plane_id) const {
+    static const std::vector<Cluster> no_clusters;
+
+    if(det_id < 0 || det_id >= max_detectors || plane_id < 0 || plane_id >= max_planes) {
+        return no_clusters;
+    }
+    auto index = m_bucketIndex[bucketKey(det_id, plane_id)];
+    return index < 0 ? no_clusters : m_buckets[static_cast<size_t>(index)];
+}
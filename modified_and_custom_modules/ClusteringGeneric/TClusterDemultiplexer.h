@@ -0,0 +1,129 @@
+/**
+ * @file
+ * @brief Definition of the shared TCluster TTree reader of ClusteringGeneric
+ *
+ * @copyright Copyright (c) 2020 CERN and the Corryvreckan authors.
+ * This software is distributed under the terms of the MIT License, copied verbatim in the file "LICENSE.md".
+ * In applying this license, CERN does not waive the privileges and immunities granted to it by virtue of its status as an
+ * Intergovernmental Organization or submit itself to any jurisdiction.
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef TClusterDemultiplexer_H
+#define TClusterDemultiplexer_H 1
+
+#include <TFile.h>
+#include <TTree.h>
+#include <TTreeReader.h>
+#include <TTreeReaderArray.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "tools/AsyncInput.h"
+
+namespace corryvreckan {
+    /**
+     * @brief Reader of the AMORE TCluster TTree shared by all ClusteringGeneric instances
+     *
+     * Every detector registers its detID once. Each TCluster entry is then decoded a single time, and its clusters are
+     * put in the bucket of their (detID, planeID), from where each detector instance picks up its own X and Y clusters.
+     * This way the file is read once per run instead of once per detector, and no instance has to scan the clusters of
+     * the other detectors.
+     */
+    class TClusterDemultiplexer {
+
+    public:
+        // Strip cluster of one plane handed to the detector instances
+        struct Cluster {
+            float pos;
+            float adc;
+        };
+
+        /**
+         * @brief Get the reader of an input file, the file is opened by the first caller
+         * @param file_name ROOT file containing the TCluster TTree
+         * @param async_input Read-ahead settings, only used by the caller that opens the file
+         */
+        static std::shared_ptr<TClusterDemultiplexer> getInstance(const std::string& file_name,
+                                                                   const AsyncInputSettings& async_input);
+
+        ~TClusterDemultiplexer();
+
+        /**
+         * @brief Request the clusters of a detector to be kept
+         * @param det_id Detector ID in the TCluster TTree
+         */
+        void registerDetector(int det_id);
+
+        /**
+         * @brief Decode a TCluster entry, unless another instance already decoded it
+         * @param entry Entry number in the TCluster TTree
+         */
+        void loadEvent(Long64_t entry);
+
+        /**
+         * @brief Clusters of the current entry for one plane of a registered detector
+         * @param det_id Detector ID in the TCluster TTree
+         * @param plane_id Plane ID in the TCluster TTree, 0 for X and 1 for Y strips
+         */
+        const std::vector<Cluster>& getClusters(int det_id, int plane_id) const;
+
+        // Number of clusters of all detectors in the current entry
+        size_t getEntrySize() const { return m_entrySize; }
+
+        // Event ID of the current entry, -1 if it holds no clusters
+        int getEventID() const { return m_eventID; }
+
+        Long64_t getEntries() const { return number_of_entries; }
+
+        /**
+         * @brief Log the time spent in the ROOT reads of the file, only the first instance calling it reports
+         */
+        void reportInputTime();
+
+    private:
+        TClusterDemultiplexer(const std::string& file_name, const AsyncInputSettings& async_input);
+
+        // Only the X and Y planes of detIDs below max_detectors are kept
+        static constexpr int max_detectors = 256;
+        static constexpr int max_planes = 2;
+        static size_t bucketKey(int det_id, int plane_id) {
+            return static_cast<size_t>(det_id) * max_planes + static_cast<size_t>(plane_id);
+        }
+
+        std::string m_inputFile;
+        TFile* data_file;
+        Long64_t number_of_entries;
+        Long64_t m_entry{-1};
+
+        TTreeReader* reader;
+        TTreeReaderArray<int>* evtID;
+        TTreeReaderArray<int>* detID;
+        TTreeReaderArray<int>* planeID;
+        TTreeReaderArray<float>* clustPos;
+        TTreeReaderArray<float>* clustADCs;
+
+        size_t m_entrySize{0};
+        int m_eventID{-1};
+
+        // Time spent reading the entries, without the bucketing of the clusters
+        InputStallTimer input_time;
+        long m_entriesRead{0};
+        bool m_inputReported{false};
+
+        // Index of the bucket for each (detID, planeID), -1 for detectors nobody asked for
+        std::vector<int> m_bucketIndex;
+        std::vector<std::vector<Cluster>> m_buckets;
+
+        std::mutex m_mutex;
+
+        static std::map<std::string, std::weak_ptr<TClusterDemultiplexer>> instances_;
+        static std::mutex instances_mutex_;
+    };
+
+} // namespace corryvreckan
+#endif // TClusterDemultiplexer_H
@@ -0,0 +1,107 @@
+/**
+ * @file
+ * @brief Implementation of the cache file of the matched XY clusters of EventLoaderAPV25
+ *
+ * @copyright Copyright (c) 2020 CERN and the Corryvreckan authors.
+ * This software is distributed under the terms of the MIT License, copied verbatim in the file "LICENSE.md".
+ * In applying this license, CERN does not waive the privileges and immunities granted to it by virtue of its status as an
+ * Intergovernmental Organization or submit itself to any jurisdiction.
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "APV25ClusterCache.h"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace corryvreckan;
+
+namespace {
+    const char cache_magic[8] = {'A', 'P', 'V', '2', '5', 'X', 'Y', '\0'};
+} // namespace
+
+uint64_t APV25ClusterCache::key(const std::string& input_file, const std::string& settings) {
+    auto fingerprint = fileFingerprint(input_file);
+    if(fingerprint == 0) {
+        return 0;
+    }
+    auto hash = fnv1a(settings.data(), settings.size(), fingerprint);
+    return hash == 0 ? 1 : hash;
+}
+
+bool APV25ClusterCache::open(const std::string& path, uint64_t key) {
+    m_records = nullptr;
+    m_index = nullptr;
+    m_events = 0;
+    if(!m_file.open(path) || m_file.size() < sizeof(Header)) {
+        m_file.close();
+        return false;
+    }
+
+    auto header = m_file.at<Header>(0);
+    auto valid = std::memcmp(header->magic, cache_magic, sizeof(cache_magic)) == 0 && header->version == version &&
+                 header->record_size == sizeof(Record) && header->key == key && header->index_offset >= sizeof(Header) &&
+                 header->index_offset <= m_file.size() &&
+                 (m_file.size() - header->index_offset) / sizeof(uint64_t) == header->events + 1;
+    if(valid) {
+        m_index = m_file.at<uint64_t>(header->index_offset);
+        valid = m_index[header->events] * sizeof(Record) == header->index_offset - sizeof(Header);
+    }
+    if(!valid) {
+        m_file.close();
+        m_index = nullptr;
+        return false;
+    }
+
+    m_records = m_file.at<Record>(sizeof(Header));
+    m_events = header->events;
+    return true;
+}
+
+bool APV25ClusterCache::create(const std::string& path, uint64_t key) {
+    m_path = path;
+    m_key = key;
+    m_writeIndex.assign(1, 0);
+    m_output.open(m_path + ".tmp", std::ios::binary | std::ios::trunc);
+    if(!m_output) {
+        return false;
+    }
+
+    // The header is written with the event count once all events are in
+    Header header{};
+    m_output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    return static_cast<bool>(m_output);
+}
+
+void APV25ClusterCache::write(const std::vector<Record>& records) {
+    m_output.write(reinterpret_cast<const char*>(records.data()), static_cast<std::streamsize>(records.size() * sizeof(Record)));
+    m_writeIndex.push_back(m_writeIndex.back() + records.size());
+}
+
+bool APV25ClusterCache::commit() {
+    Header header{};
+    std::memcpy(header.magic, cache_magic, sizeof(cache_magic));
+    header.version = version;
+    header.record_size = sizeof(Record);
+    header.key = m_key;
+    header.events = m_writeIndex.size() - 1;
+    header.index_offset = sizeof(Header) + m_writeIndex.back() * sizeof(Record);
+
+    m_output.write(reinterpret_cast<const char*>(m_writeIndex.data()),
+                   static_cast<std::streamsize>(m_writeIndex.size() * sizeof(uint64_t)));
+    m_output.seekp(0);
+    m_output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    m_output.close();
+    if(m_output.fail() || std::rename((m_path + ".tmp").c_str(), m_path.c_str()) != 0) {
+        std::remove((m_path + ".tmp").c_str());
+        return false;
+    }
+    return true;
+}
+
+void APV25ClusterCache::discard() {
+    if(m_output.is_open()) {
+        m_output.close();
+        std::remove((m_path + ".tmp").c_str());
+    }
+}
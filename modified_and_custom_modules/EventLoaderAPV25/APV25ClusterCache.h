@@ -0,0 +1,113 @@
+/**
+ * @file
+ * @brief Definition of the cache file of the matched XY clusters of EventLoaderAPV25
+ *
+ * @copyright Copyright (c) 2020 CERN and the Corryvreckan authors.
+ * This software is distributed under the terms of the MIT License, copied verbatim in the file "LICENSE.md".
+ * In applying this license, CERN does not waive the privileges and immunities granted to it by virtue of its status as an
+ * Intergovernmental Organization or submit itself to any jurisdiction.
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef APV25ClusterCache_H
+#define APV25ClusterCache_H 1
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "tools/MappedFile.h"
+
+namespace corryvreckan {
+    /**
+     * @brief Matched XY clusters of all events of a detector, written once and memory-mapped by later runs
+     *
+     * The file holds a header, the clusters of all events one after the other as fixed size records, and the index of
+     * the first record of every event. The header has a format version and a key made from the input file and the
+     * loader settings. A cache with another version or key is not used and is rewritten by the run.
+     *
+     * The cache is written to a temporary file next to it, which only replaces the cache once all events are written.
+     */
+    class APV25ClusterCache {
+
+    public:
+        // Version 2 keeps the strip positions as doubles, version 1 had them cut to whole strips
+        static constexpr uint32_t version = 2;
+
+        struct Record {
+            double column;
+            double row;
+            int32_t charge;
+            int32_t reserved;
+            double time;
+        };
+
+        /**
+         * @brief Key of a cache
+         * @param input_file Input file, see fileFingerprint()
+         * @param settings All loader settings that change the clusters
+         * @return Zero if the input file cannot be read
+         */
+        static uint64_t key(const std::string& input_file, const std::string& settings);
+
+        /**
+         * @brief Map an existing cache for reading
+         * @return False if there is no valid cache with this version and key at the path
+         */
+        bool open(const std::string& path, uint64_t key);
+
+        size_t events() const { return m_events; }
+        const Record* begin(size_t event) const { return m_records + m_index[event]; }
+        const Record* end(size_t event) const { return m_records + m_index[event + 1]; }
+
+        /**
+         * @brief Start writing a new cache
+         * @return False if the temporary file cannot be created
+         */
+        bool create(const std::string& path, uint64_t key);
+
+        /**
+         * @brief Append the clusters of the next event
+         */
+        void write(const std::vector<Record>& records);
+
+        /**
+         * @brief Finish the cache and move it into place
+         * @return False if writing failed, the temporary file is removed then
+         */
+        bool commit();
+
+        /**
+         * @brief Drop the cache being written
+         */
+        void discard();
+
+        bool writing() const { return m_output.is_open(); }
+
+    private:
+        struct Header {
+            char magic[8];
+            uint32_t version;
+            uint32_t record_size;
+            uint64_t key;
+            uint64_t events;
+            uint64_t index_offset;
+        };
+
+        // Reading
+        MappedFile m_file;
+        const Record* m_records{nullptr};
+        const uint64_t* m_index{nullptr};
+        size_t m_events{0};
+
+        // Writing
+        std::string m_path;
+        std::ofstream m_output;
+        uint64_t m_key{0};
+        std::vector<uint64_t> m_writeIndex;
+    };
+
+} // namespace corryvreckan
+#endif // APV25ClusterCache_H
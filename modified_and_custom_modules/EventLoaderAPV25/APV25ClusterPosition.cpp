@@ -0,0 +1,104 @@
+/**
+ * @file
+ * @brief Implementation of the strip cluster position estimators of EventLoaderAPV25
+ *
+ * @copyright Copyright (c) 2020 CERN and the Corryvreckan authors.
+ * This software is distributed under the terms of the MIT License, copied verbatim in the file "LICENSE.md".
+ * In applying this license, CERN does not waive the privileges and immunities granted to it by virtue of its status as an
+ * Intergovernmental Organization or submit itself to any jurisdiction.
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "APV25ClusterPosition.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace corryvreckan;
+
+APV25ClusterPosition::APV25ClusterPosition(Estimator estimator, std::vector<double> eta_correction)
+    : m_estimator(estimator), m_etaCorrection(std::move(eta_correction)) {}
+
+double APV25ClusterPosition::estimate(const std::vector<int>& strips, const std::vector<int>& adcs, double* eta) const {
+    switch(m_estimator) {
+    case Estimator::GAUSSIAN3:
+        return gaussian3(strips, adcs);
+    case Estimator::ETA:
+        return etaPosition(strips, adcs, eta);
+    default:
+        return centroid(strips, adcs);
+    }
+}
+
+double APV25ClusterPosition::centroid(const std::vector<int>& strips, const std::vector<int>& adcs) {
+    double sum = 0;
+    double weighted = 0;
+    for(size_t i = 0; i < strips.size(); i++) {
+        auto charge = std::max(adcs[i], 0);
+        sum += charge;
+        weighted += static_cast<double>(charge) * strips[i];
+    }
+
+    // No charge at all, take the middle of the cluster
+    if(sum <= 0) {
+        return 0.5 * (strips.front() + strips.back());
+    }
+    return weighted / sum;
+}
+
+double APV25ClusterPosition::gaussian3(const std::vector<int>& strips, const std::vector<int>& adcs) {
+    auto max = maximum(adcs);
+    if(max == 0 || max + 1 >= strips.size() || adcs[max - 1] <= 0 || adcs[max + 1] <= 0) {
+        return centroid(strips, adcs);
+    }
+
+    auto left = std::log(adcs[max - 1]);
+    auto centre = std::log(adcs[max]);
+    auto right = std::log(adcs[max + 1]);
+
+    // The logarithm of a Gaussian is a parabola, which has to open downwards
+    auto curvature = left - 2 * centre + right;
+    if(curvature >= 0) {
+        return centroid(strips, adcs);
+    }
+    return strips[max] + 0.5 * (left - right) / curvature;
+}
+
+double APV25ClusterPosition::etaPosition(const std::vector<int>& strips, const std::vector<int>& adcs, double* eta) const {
+    auto max = maximum(adcs);
+
+    // Pair the highest strip with its higher neighbour
+    size_t left = 0;
+    if(max + 1 < strips.size() && (max == 0 || adcs[max + 1] >= adcs[max - 1])) {
+        left = max;
+    } else if(max > 0) {
+        left = max - 1;
+    } else {
+        return centroid(strips, adcs);
+    }
+
+    auto q_left = std::max(adcs[left], 0);
+    auto q_right = std::max(adcs[left + 1], 0);
+    if(q_left + q_right <= 0) {
+        return centroid(strips, adcs);
+    }
+
+    auto value = static_cast<double>(q_right) / (q_left + q_right);
+    if(eta != nullptr) {
+        *eta = value;
+    }
+
+    // Map eta to a uniform distribution between the strips with the measured cumulative distribution
+    if(m_etaCorrection.size() >= 2) {
+        auto bins = static_cast<double>(m_etaCorrection.size() - 1);
+        auto bin = std::min(static_cast<size_t>(value * bins), m_etaCorrection.size() - 2);
+        auto fraction = value * bins - static_cast<double>(bin);
+        value = m_etaCorrection[bin] + fraction * (m_etaCorrection[bin + 1] - m_etaCorrection[bin]);
+    }
+
+    return strips[left] + value;
+}
+
+size_t APV25ClusterPosition::maximum(const std::vector<int>& adcs) {
+    return static_cast<size_t>(std::max_element(adcs.begin(), adcs.end()) - adcs.begin());
+}
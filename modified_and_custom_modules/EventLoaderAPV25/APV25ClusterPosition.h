@@ -0,0 +1,62 @@
+/**
+ * @file
+ * @brief Definition of the strip cluster position estimators of EventLoaderAPV25
+ *
+ * @copyright Copyright (c) 2020 CERN and the Corryvreckan authors.
+ * This software is distributed under the terms of the MIT License, copied verbatim in the file "LICENSE.md".
+ * In applying this license, CERN does not waive the privileges and immunities granted to it by virtue of its status as an
+ * Intergovernmental Organization or submit itself to any jurisdiction.
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef APV25ClusterPosition_H
+#define APV25ClusterPosition_H 1
+
+#include <cstddef>
+#include <vector>
+
+namespace corryvreckan {
+    /**
+     * @brief Position of a cluster of adjacent strips, computed directly from the strip and ADC arrays
+     *
+     * The estimators replace the Gaussian fit of a histogram per cluster:
+     * - centroid: charge weighted mean of all strips
+     * - gaussian3: vertex of the parabola through the logarithms of the highest strip and its two neighbours
+     * - eta: position between the two highest adjacent strips from their charge sharing eta = q_right / (q_left + q_right),
+     *   optionally corrected with the cumulative eta distribution measured in a previous run
+     * Strips with a negative ADC value do not add to the charge. If an estimator cannot be applied to a cluster, e.g. a
+     * two strip cluster for gaussian3, the centroid is used.
+     */
+    class APV25ClusterPosition {
+
+    public:
+        enum class Estimator { CENTROID, GAUSSIAN3, ETA };
+
+        /**
+         * @brief Constructor
+         * @param estimator Estimator used by estimate()
+         * @param eta_correction Cumulative eta distribution at equally spaced eta from 0 to 1, empty for no correction
+         */
+        explicit APV25ClusterPosition(Estimator estimator = Estimator::CENTROID, std::vector<double> eta_correction = {});
+
+        /**
+         * @brief Position of a cluster
+         * @param strips Strip numbers, ascending and adjacent
+         * @param adcs ADC values of the strips
+         * @param eta Set to the eta value of the cluster in eta mode, untouched otherwise
+         */
+        double estimate(const std::vector<int>& strips, const std::vector<int>& adcs, double* eta = nullptr) const;
+
+        static double centroid(const std::vector<int>& strips, const std::vector<int>& adcs);
+        static double gaussian3(const std::vector<int>& strips, const std::vector<int>& adcs);
+        double etaPosition(const std::vector<int>& strips, const std::vector<int>& adcs, double* eta) const;
+
+    private:
+        static size_t maximum(const std::vector<int>& adcs);
+
+        Estimator m_estimator;
+        std::vector<double> m_etaCorrection;
+    };
+
+} // namespace corryvreckan
+#endif // APV25ClusterPosition_H
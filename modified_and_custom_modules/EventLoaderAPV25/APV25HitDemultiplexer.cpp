@@ -0,0 +1,211 @@
+/**
+ * @file
+ * @brief Implementation of the shared THit TTree reader of EventLoaderAPV25
+ *
+ * @copyright Copyright (c) 2020 CERN and the Corryvreckan authors.
+ * This software is distributed under the terms of the MIT License, copied verbatim in the file "LICENSE.md".
+ * In applying this license, CERN does not waive the privileges and immunities granted to it by virtue of its status as an
+ * Intergovernmental Organization or submit itself to any jurisdiction.
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "APV25HitDemultiplexer.h"
+
+#include "core/module/exceptions.h"
+#include "core/utils/log.h"
+
+using namespace corryvreckan;
+
+std::map<std::string, std::weak_ptr<APV25HitDemultiplexer>> APV25HitDemultiplexer::instances_;
+std::mutex APV25HitDemultiplexer::instances_mutex_;
+
+std::shared_ptr<APV25HitDemultiplexer>
+APV25HitDemultiplexer::getInstance(const std::string& file_name,
+                                   int timebins,
+                                   const AsyncInputSettings& async_input,
+                                   size_t batch_size) {
+    std::lock_guard<std::mutex> lock(instances_mutex_);
+
+    auto instance = instances_[file_name].lock();
+    if(!instance) {
+        instance = std::shared_ptr<APV25HitDemultiplexer>(new APV25HitDemultiplexer(file_name, timebins, async_input, batch_size));
+        instances_[file_name] = instance;
+    }
+    if(instance->m_timebins != timebins) {
+        throw ModuleError("File " + file_name + " is read with " + std::to_string(instance->m_timebins) +
+                          " time bins by another detector, not " + std::to_string(timebins));
+    }
+    if(instance->m_batchSize != batch_size) {
+        throw ModuleError("File " + file_name + " is read in batches of " + std::to_string(instance->m_batchSize) +
+                          " events by another detector, not " + std::to_string(batch_size) +
+                          "; event_batch_size has to be the same for all detectors reading a file");
+    }
+    return instance;
+}
+
+APV25HitDemultiplexer::APV25HitDemultiplexer(const std::string& file_name,
+                                             int timebins,
+                                             const AsyncInputSettings& async_input,
+                                             size_t batch_size)
+    : m_inputFile(file_name), m_timebins(timebins), m_batchSize(batch_size) {
+
+    prepareAsyncInput(async_input);
+    data_file = TFile::Open(m_inputFile.c_str());
+    if(!data_file || data_file->IsZombie()) {
+        LOG(DEBUG) << "Failed to open the data file: " << m_inputFile;
+        throw ModuleError("Error in opening TFile");
+    }
+
+    data_tree = dynamic_cast<TTree*>(data_file->Get("THit"));
+    if(!data_tree) {
+        LOG(ERROR) << "Failed to retrieve TTree 'THit' from file";
+        throw ModuleError("Failed to retrieve TTree 'THit'");
+    }
+
+    configureAsyncInput(data_tree, async_input);
+    number_of_entries = data_tree->GetEntries();
+    LOG(DEBUG) << "Number of entries in data_tree " << number_of_entries;
+
+    reader = new TTreeReader("THit", data_file);
+    evtID = new TTreeReaderValue<int>(*reader, "evtID");
+    nch = new TTreeReaderValue<int>(*reader, "nch");
+    detID = new TTreeReaderArray<int>(*reader, "detID");
+    planeID = new TTreeReaderArray<int>(*reader, "planeID");
+    strip = new TTreeReaderArray<int>(*reader, "strip");
+
+    // The peak is found from the samples, so hitTimebin is not read
+    for(int t = 0; t < m_timebins; t++) {
+        adcs.push_back(new TTreeReaderArray<int16_t>(*reader, ("adc" + std::to_string(t)).c_str()));
+    }
+}
+
+APV25HitDemultiplexer::~APV25HitDemultiplexer() {
+    for(auto adc : adcs) {
+        delete adc;
+    }
+    delete strip;
+    delete planeID;
+    delete detID;
+    delete nch;
+    delete evtID;
+    delete reader;
+    delete data_file;
+}
+
+void APV25HitDemultiplexer::registerDetector(int det_id) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if(det_id < 0) {
+        throw ModuleError("Negative detID " + std::to_string(det_id) + " requested from " + m_inputFile);
+    }
+    auto key = static_cast<size_t>(det_id);
+    if(key >= m_detectorIndex.size()) {
+        m_detectorIndex.resize(key + 1, -1);
+    }
+    if(m_detectorIndex[key] < 0) {
+        m_detectorIndex[key] = static_cast<int>(m_registered++);
+    }
+}
+
+size_t APV25HitDemultiplexer::loadBatch(long first) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto count = m_batchSize;
+
+    // Another detector instance already read this batch
+    if(first == m_first && m_count > 0) {
+        return m_loaded;
+    }
+    if(first != m_first + static_cast<long>(m_count)) {
+        throw ModuleError("Events " + std::to_string(first) + " to " + std::to_string(first + static_cast<long>(count)) +
+                          " requested from " + m_inputFile + " after events " + std::to_string(m_first) + " to " +
+                          std::to_string(m_first + static_cast<long>(m_count)) +
+                          ", all detectors reading a file have to read the same events");
+    }
+    m_first = first;
+    m_count = count;
+
+    // The hits of each slot are kept, so their buffers are reused by the following batches
+    if(m_batch.size() < count) {
+        m_batch.resize(count);
+    }
+    m_eventIDs.resize(count);
+    m_loaded = 0;
+    for(; m_loaded < count && first + static_cast<long>(m_loaded) < number_of_entries; m_loaded++) {
+        auto& detectors = m_batch[m_loaded];
+        while(detectors.size() < m_registered) {
+            detectors.push_back({{}, {}, APV25WaveformMatrix(static_cast<size_t>(m_timebins))});
+        }
+        readEntry(first + static_cast<long>(m_loaded), detectors);
+        m_eventIDs[m_loaded] = **evtID;
+    }
+    return m_loaded;
+}
+
+void APV25HitDemultiplexer::readEntry(Long64_t entry, std::vector<DetectorHits>& detectors) {
+    for(auto& detector : detectors) {
+        detector.planes.clear();
+        detector.strips.clear();
+    }
+
+    {
+        // The branches are read on first access, so they are all touched here
+        auto stall = input_time.measure();
+        reader->SetLocalEntry(entry);
+        static_cast<void>(**evtID);
+        static_cast<void>(**nch);
+        for(auto array : {detID, planeID, strip}) {
+            array->GetSize();
+        }
+        for(auto adc : adcs) {
+            adc->GetSize();
+        }
+    }
+
+    // Split the channels by detID, each channel becomes the next row of its detector
+    auto channels = static_cast<size_t>(**nch);
+    channel_detector.assign(channels, -1);
+    channel_row.resize(channels);
+    for(size_t i = 0; i < channels; i++) {
+        auto det_id = detID->At(i);
+        if(det_id < 0 || static_cast<size_t>(det_id) >= m_detectorIndex.size() ||
+           m_detectorIndex[static_cast<size_t>(det_id)] < 0) {
+            continue;
+        }
+        auto index = m_detectorIndex[static_cast<size_t>(det_id)];
+        auto& detector = detectors[static_cast<size_t>(index)];
+        channel_detector[i] = index;
+        channel_row[i] = detector.strips.size();
+        detector.planes.push_back(planeID->At(i));
+        detector.strips.push_back(strip->At(i));
+    }
+    for(auto& detector : detectors) {
+        detector.waveforms.resize(detector.strips.size());
+    }
+
+    // Fill the matrices one time bin branch at a time
+    for(size_t t = 0; t < adcs.size(); t++) {
+        auto& adc = *adcs[t];
+        for(size_t i = 0; i < channels; i++) {
+            if(channel_detector[i] >= 0) {
+                detectors[static_cast<size_t>(channel_detector[i])].waveforms.row(channel_row[i])[t] = adc.At(i);
+            }
+        }
+    }
+}
+
+void APV25HitDemultiplexer::reportInputTime() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if(!m_inputReported) {
+        m_inputReported = true;
+        input_time.report(m_inputFile, m_first + static_cast<long>(m_loaded));
+    }
+}
+
+APV25HitDemultiplexer::DetectorHits& APV25HitDemultiplexer::getHits(int det_id, size_t event) {
+    auto index = m_detectorIndex.at(static_cast<size_t>(det_id));
+    if(index < 0) {
+        throw ModuleError("detID " + std::to_string(det_id) + " was not registered with " + m_inputFile);
+    }
+    return m_batch.at(event)[static_cast<size_t>(index)];
+}
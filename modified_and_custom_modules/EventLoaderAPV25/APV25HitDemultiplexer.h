@@ -0,0 +1,140 @@
+/**
+ * @file
+ * @brief Definition of the shared THit TTree reader of EventLoaderAPV25
+ *
+ * @copyright Copyright (c) 2020 CERN and the Corryvreckan authors.
+ * This software is distributed under the terms of the MIT License, copied verbatim in the file "LICENSE.md".
+ * In applying this license, CERN does not waive the privileges and immunities granted to it by virtue of its status as an
+ * Intergovernmental Organization or submit itself to any jurisdiction.
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef APV25HitDemultiplexer_H
+#define APV25HitDemultiplexer_H 1
+
+#include <TFile.h>
+#include <TTree.h>
+#include <TTreeReader.h>
+#include <TTreeReaderArray.h>
+#include <TTreeReaderValue.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "APV25WaveformMatrix.h"
+#include "tools/AsyncInput.h"
+
+namespace corryvreckan {
+    /**
+     * @brief Reader of the AMORE THit TTree shared by all EventLoaderAPV25 instances
+     *
+     * Every detector registers its detID once. Each THit entry is then read and decompressed a single time per event,
+     * and its channels are split by detID: the strips of a detector get their plane and strip number and one row of
+     * samples in the waveform matrix of that detector. Each detector instance works on its own hits only, and may
+     * correct the samples of its matrix in place.
+     *
+     * Events are read in batches of consecutive entries, so the events of a batch can be reconstructed in parallel. The
+     * batch size is a setting of the file, the same for all instances reading it whether they reconstruct in parallel
+     * or one event at a time.
+     */
+    class APV25HitDemultiplexer {
+
+    public:
+        // Channels of one detector in the current event, row i of the matrix belongs to planes[i] and strips[i]
+        struct DetectorHits {
+            std::vector<int> planes;
+            std::vector<int> strips;
+            APV25WaveformMatrix waveforms;
+        };
+
+        /**
+         * @brief Get the reader of an input file, the file is opened by the first caller
+         * @param file_name ROOT file containing the THit TTree
+         * @param timebins Number of samples per channel, the same for all callers
+         * @param async_input Read-ahead settings, only used by the caller that opens the file
+         * @param batch_size Number of events per batch, the same for all callers
+         */
+        static std::shared_ptr<APV25HitDemultiplexer>
+        getInstance(const std::string& file_name, int timebins, const AsyncInputSettings& async_input, size_t batch_size);
+
+        ~APV25HitDemultiplexer();
+
+        /**
+         * @brief Request the channels of a detector to be kept
+         * @param det_id Detector ID in the THit TTree
+         */
+        void registerDetector(int det_id);
+
+        /**
+         * @brief Read a batch of events, unless another instance already read it
+         * @param first Entry number of the first event in the THit TTree
+         * @return Number of events read, less than the batch size at the end of the file
+         */
+        size_t loadBatch(long first);
+
+        /**
+         * @brief Channels of one registered detector in an event of the current batch
+         */
+        DetectorHits& getHits(int det_id, size_t event = 0);
+
+        int getEventID(size_t event = 0) const { return m_eventIDs[event]; }
+        Long64_t getEntries() const { return number_of_entries; }
+        size_t batchSize() const { return m_batchSize; }
+
+        /**
+         * @brief Log the time spent in the ROOT reads of the file, only the first instance calling it reports
+         */
+        void reportInputTime();
+
+    private:
+        APV25HitDemultiplexer(const std::string& file_name, int timebins, const AsyncInputSettings& async_input, size_t batch_size);
+
+        std::string m_inputFile;
+        int m_timebins;
+        size_t m_batchSize;
+        TFile* data_file;
+        TTree* data_tree;
+        Long64_t number_of_entries;
+
+        TTreeReader* reader;
+        TTreeReaderValue<int>* evtID;
+        TTreeReaderValue<int>* nch;
+        TTreeReaderArray<int>* detID;
+        TTreeReaderArray<int>* planeID;
+        TTreeReaderArray<int>* strip;
+        // One branch adc<n> per time bin
+        std::vector<TTreeReaderArray<int16_t>*> adcs;
+
+        // Read one entry into the hits of the detectors
+        void readEntry(Long64_t entry, std::vector<DetectorHits>& detectors);
+
+        // Current batch, the events [m_first, m_first + m_loaded) of m_count requested, m_count is zero before the first batch
+        long m_first{0};
+        size_t m_count{0};
+        size_t m_loaded{0};
+        std::vector<int> m_eventIDs;
+
+        // Index of the hits of each detID, -1 for detectors nobody asked for, and the hits per event of the batch
+        std::vector<int> m_detectorIndex;
+        size_t m_registered{0};
+        std::vector<std::vector<DetectorHits>> m_batch;
+
+        // Time spent reading the entries, without splitting the channels into the detectors
+        InputStallTimer input_time;
+        bool m_inputReported{false};
+
+        // Detector index and matrix row of each channel of the current entry, -1 for channels not kept
+        std::vector<int> channel_detector;
+        std::vector<size_t> channel_row;
+
+        std::mutex m_mutex;
+
+        static std::map<std::string, std::weak_ptr<APV25HitDemultiplexer>> instances_;
+        static std::mutex instances_mutex_;
+    };
+
+} // namespace corryvreckan
+#endif // APV25HitDemultiplexer_H
@@ -0,0 +1,80 @@
+/**
+ * @file
+ * @brief Implementation of the strip hit buffer of one APV25 plane
+ *
+ * @copyright Copyright (c) 2020 CERN and the Corryvreckan authors.
+ * This software is distributed under the terms of the MIT License, copied verbatim in the file "LICENSE.md".
+ * In applying this license, CERN does not waive the privileges and immunities granted to it by virtue of its status as an
+ * Intergovernmental Organization or submit itself to any jurisdiction.
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "APV25PlaneHits.h"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+using namespace corryvreckan;
+
+void APV25PlaneHits::reserve(size_t strips) {
+    // At most one hit per strip is expected, duplicates only grow the hit arrays once
+    m_strips.reserve(strips);
+    m_adcs.reserve(strips);
+    m_rows.reserve(strips);
+    m_sortedStrips.reserve(strips);
+    m_sortedAdcs.reserve(strips);
+    m_sortedRows.reserve(strips);
+    if(m_offsets.size() < strips + 1) {
+        m_offsets.resize(strips + 1);
+    }
+}
+
+void APV25PlaneHits::add(int strip, int16_t adc, int32_t row) {
+    if(strip < 0 || strip > std::numeric_limits<int16_t>::max()) {
+        return;
+    }
+    if(static_cast<size_t>(strip) + 1 >= m_offsets.size()) {
+        m_offsets.resize(static_cast<size_t>(strip) + 2);
+    }
+    m_strips.push_back(static_cast<int16_t>(strip));
+    m_adcs.push_back(adc);
+    m_rows.push_back(row);
+}
+
+void APV25PlaneHits::sort() {
+    auto hits = m_strips.size();
+    if(hits < 2) {
+        return;
+    }
+
+    // Histogram of the strips shifted by one, the prefix sum is then the first position of every strip
+    std::fill(m_offsets.begin(), m_offsets.end(), 0);
+    for(auto strip : m_strips) {
+        m_offsets[static_cast<size_t>(strip) + 1]++;
+    }
+    for(size_t strip = 1; strip < m_offsets.size(); strip++) {
+        m_offsets[strip] += m_offsets[strip - 1];
+    }
+
+    m_sortedStrips.resize(hits);
+    m_sortedAdcs.resize(hits);
+    m_sortedRows.resize(hits);
+    for(size_t i = 0; i < hits; i++) {
+        auto position = static_cast<size_t>(m_offsets[static_cast<size_t>(m_strips[i])]++);
+        m_sortedStrips[position] = m_strips[i];
+        m_sortedAdcs[position] = m_adcs[i];
+        m_sortedRows[position] = m_rows[i];
+    }
+    m_strips.swap(m_sortedStrips);
+    m_adcs.swap(m_sortedAdcs);
+    m_rows.swap(m_sortedRows);
+
+    // Several hits on one strip are rare and short runs, insertion sort them by descending ADC
+    for(size_t i = 1; i < hits; i++) {
+        for(size_t j = i; j > 0 && m_strips[j] == m_strips[j - 1] && m_adcs[j] > m_adcs[j - 1]; j--) {
+            std::swap(m_adcs[j], m_adcs[j - 1]);
+            std::swap(m_rows[j], m_rows[j - 1]);
+        }
+    }
+}
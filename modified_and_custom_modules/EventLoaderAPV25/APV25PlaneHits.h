@@ -0,0 +1,75 @@
+/**
+ * @file
+ * @brief Definition of the strip hit buffer of one APV25 plane
+ *
+ * @copyright Copyright (c) 2020 CERN and the Corryvreckan authors.
+ * This software is distributed under the terms of the MIT License, copied verbatim in the file "LICENSE.md".
+ * In applying this license, CERN does not waive the privileges and immunities granted to it by virtue of its status as an
+ * Intergovernmental Organization or submit itself to any jurisdiction.
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef APV25PlaneHits_H
+#define APV25PlaneHits_H 1
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace corryvreckan {
+    /**
+     * @brief Hits of one strip plane in an event, stored as separate strip, ADC and waveform row arrays
+     *
+     * The buffer is sized once for the strips of the plane and reused for every event, so no memory is allocated in the
+     * event loop. The hits are ordered by strip with a counting sort over the strip numbers, which needs one pass over the
+     * hits and one over the strips instead of a comparison sort. Hits on the same strip are ordered by descending ADC.
+     */
+    class APV25PlaneHits {
+
+    public:
+        /**
+         * @brief Size the buffer for a plane
+         * @param strips Number of strips of the plane, higher strip numbers grow the buffer when they are added
+         */
+        void reserve(size_t strips);
+
+        void clear() {
+            m_strips.clear();
+            m_adcs.clear();
+            m_rows.clear();
+        }
+
+        /**
+         * @brief Add a hit, strip numbers that are negative or do not fit into int16_t are not added
+         * @param strip Strip number, as read from the THit TTree
+         * @param adc Peak ADC value
+         * @param row Row of the hit in the waveform matrix
+         */
+        void add(int strip, int16_t adc, int32_t row);
+
+        /**
+         * @brief Order the hits by ascending strip and descending ADC
+         */
+        void sort();
+
+        size_t size() const { return m_strips.size(); }
+        bool empty() const { return m_strips.empty(); }
+
+        int16_t strip(size_t index) const { return m_strips[index]; }
+        int16_t adc(size_t index) const { return m_adcs[index]; }
+        int32_t row(size_t index) const { return m_rows[index]; }
+
+    private:
+        std::vector<int16_t> m_strips;
+        std::vector<int16_t> m_adcs;
+        std::vector<int32_t> m_rows;
+
+        // Start of every strip in the sorted arrays and the sorted arrays, swapped with the ones above
+        std::vector<int32_t> m_offsets;
+        std::vector<int16_t> m_sortedStrips;
+        std::vector<int16_t> m_sortedAdcs;
+        std::vector<int32_t> m_sortedRows;
+    };
+
+} // namespace corryvreckan
+#endif // APV25PlaneHits_H
@@ -0,0 +1,124 @@
+/**
+ * @file
+ * @brief Implementation of the pulse shape timing of the APV25 strips of EventLoaderAPV25
+ *
+ * @copyright Copyright (c) 2020 CERN and the Corryvreckan authors.
+ * This software is distributed under the terms of the MIT License, copied verbatim in the file "LICENSE.md".
+ * In applying this license, CERN does not waive the privileges and immunities granted to it by virtue of its status as an
+ * Intergovernmental Organization or submit itself to any jurisdiction.
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "APV25PulseTiming.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace corryvreckan;
+
+APV25PulseTiming::APV25PulseTiming(double sampling_period, double shaping_time, int order, size_t table_size)
+    : m_samplingPeriod(sampling_period), m_shapingTime(shaping_time), m_order(std::max(order, 1)) {
+
+    // Offsets of the true peak for which the peak sample is still the highest one, from a scan in small steps
+    const int steps = 2000;
+    double first = 0;
+    double last = 0;
+    bool found = false;
+    for(int i = 0; i <= steps; i++) {
+        double offset = -m_samplingPeriod + 2 * m_samplingPeriod * i / steps;
+        double peak = shape(m_order * m_shapingTime - offset);
+        if(peak >= shape(m_order * m_shapingTime - offset - m_samplingPeriod) &&
+           peak >= shape(m_order * m_shapingTime - offset + m_samplingPeriod)) {
+            if(!found) {
+                first = offset;
+                found = true;
+            }
+            last = offset;
+        }
+    }
+
+    // The peak sample is the highest one over about one sampling period of offsets. A pulse too short for the sampling
+    // leaves a range too small to resolve, the table would be meaningless then.
+    m_valid = found && std::isfinite(first) && std::isfinite(last) && last - first > 0.5 * m_samplingPeriod;
+    table_size = std::max<size_t>(table_size, 2);
+    if(!m_valid) {
+        m_asymmetryMin = 0;
+        m_asymmetryScale = 0;
+        m_offsetTable.assign(table_size, 0);
+        return;
+    }
+
+    // The asymmetry rises with the offset, the table is filled by bisection of the inverse
+    m_asymmetryMin = asymmetry(first);
+    double asymmetry_max = asymmetry(last);
+    m_asymmetryScale = static_cast<double>(table_size - 1) / (asymmetry_max - m_asymmetryMin);
+    m_offsetTable.resize(table_size);
+    for(size_t i = 0; i < table_size; i++) {
+        double target = m_asymmetryMin + static_cast<double>(i) / m_asymmetryScale;
+        double low = first;
+        double high = last;
+        for(int iteration = 0; iteration < 60; iteration++) {
+            double middle = 0.5 * (low + high);
+            (asymmetry(middle) < target ? low : high) = middle;
+        }
+        m_offsetTable[i] = 0.5 * (low + high);
+    }
+}
+
+double APV25PulseTiming::shape(double time) const {
+    if(time <= 0) {
+        return 0;
+    }
+    double x = time / m_shapingTime;
+    return std::pow(x / m_order, m_order) * std::exp(m_order - x);
+}
+
+double APV25PulseTiming::asymmetry(double offset) const {
+    double peak_time = m_order * m_shapingTime - offset;
+    double before = shape(peak_time - m_samplingPeriod);
+    double after = shape(peak_time + m_samplingPeriod);
+    return (after - before) / (after + before);
+}
+
+void APV25PulseTiming::estimate(const APV25WaveformMatrix& waveforms,
+                                const std::vector<size_t>& rows,
+                                const std::vector<int>& peak_bins,
+                                std::vector<double>& times) {
+    auto strips = rows.size();
+    auto last_bin = static_cast<int>(waveforms.timebins()) - 1;
+
+    // Gather the samples next to the peaks, a missing or negative neighbour counts as 0
+    m_before.resize(strips);
+    m_after.resize(strips);
+    for(size_t i = 0; i < strips; i++) {
+        auto samples = waveforms.row(rows[i]);
+        auto bin = peak_bins[i];
+        m_before[i] = (bin > 0) ? std::max<float>(samples[bin - 1], 0) : 0;
+        m_after[i] = (bin < last_bin) ? std::max<float>(samples[bin + 1], 0) : 0;
+    }
+
+    // Position in the lookup table, the same operations for all strips without branches so they are vectorized
+    m_position.resize(strips);
+    const float* __restrict before = m_before.data();
+    const float* __restrict after = m_after.data();
+    float* __restrict position = m_position.data();
+    const float asymmetry_min = static_cast<float>(m_asymmetryMin);
+    const float asymmetry_scale = static_cast<float>(m_asymmetryScale);
+    const float last_position = std::nextafter(static_cast<float>(m_offsetTable.size() - 1), 0.0f);
+    for(size_t i = 0; i < strips; i++) {
+        // Both neighbours at 0 gives an asymmetry of 0
+        float asymmetry = (after[i] - before[i]) / std::max(after[i] + before[i], 1e-6f);
+        position[i] = std::min(std::max((asymmetry - asymmetry_min) * asymmetry_scale, 0.0f), last_position);
+    }
+
+    // Interpolation in the table
+    times.resize(strips);
+    const double start_offset = m_order * m_shapingTime;
+    for(size_t i = 0; i < strips; i++) {
+        auto index = static_cast<size_t>(position[i]);
+        double fraction = position[i] - static_cast<float>(index);
+        double offset = m_offsetTable[index] + fraction * (m_offsetTable[index + 1] - m_offsetTable[index]);
+        bool edge = (peak_bins[i] <= 0 || peak_bins[i] >= last_bin);
+        times[i] = peak_bins[i] * m_samplingPeriod + (edge ? 0 : offset) - start_offset;
+    }
+}
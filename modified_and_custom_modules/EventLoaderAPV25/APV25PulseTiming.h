@@ -0,0 +1,91 @@
+/**
+ * @file
+ * @brief Definition of the pulse shape timing of the APV25 strips of EventLoaderAPV25
+ *
+ * @copyright Copyright (c) 2020 CERN and the Corryvreckan authors.
+ * This software is distributed under the terms of the MIT License, copied verbatim in the file "LICENSE.md".
+ * In applying this license, CERN does not waive the privileges and immunities granted to it by virtue of its status as an
+ * Intergovernmental Organization or submit itself to any jurisdiction.
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef APV25PulseTiming_H
+#define APV25PulseTiming_H 1
+
+#include <cstddef>
+#include <vector>
+
+#include "APV25WaveformMatrix.h"
+
+namespace corryvreckan {
+    /**
+     * @brief Start time of the strip pulses below the sampling period, from the samples around the peak
+     *
+     * The pulses are assumed to follow the CR-RC^n shape (t/tau)^n exp(-t/tau), which peaks at n tau after the start
+     * of the pulse. With the peak at sample p, the asymmetry (s[p+1] - s[p-1]) / (s[p+1] + s[p-1]) only depends on where
+     * the true peak lies relative to sample p. This relation is computed once from the shape and stored inverted in a
+     * table with equally spaced asymmetry values, so the time of a strip is a table lookup with linear interpolation.
+     * Pulses peaking in the first or the last time bin get the time of that bin.
+     */
+    class APV25PulseTiming {
+
+    public:
+        /**
+         * @brief Constructor
+         * @param sampling_period Time between two samples
+         * @param shaping_time Shaping time constant tau
+         * @param order Order n of the CR-RC^n shaper
+         * @param table_size Number of entries of the lookup table
+         */
+        explicit APV25PulseTiming(double sampling_period = 25,
+                                  double shaping_time = 50,
+                                  int order = 1,
+                                  size_t table_size = 1024);
+
+        /**
+         * @brief Start times of the pulses of a batch of strips, relative to the first sample
+         * @param waveforms Matrix with one row per strip
+         * @param rows Rows of the strips
+         * @param peak_bins Time bin of the peak of each strip
+         * @param times Filled with the start time of each strip
+         */
+        void estimate(const APV25WaveformMatrix& waveforms,
+                      const std::vector<size_t>& rows,
+                      const std::vector<int>& peak_bins,
+                      std::vector<double>& times);
+
+        /**
+         * @brief False if the scan of the pulse shape found too small a range of peak positions to build the table,
+         * e.g. for a peaking time far below the sampling period; the times are meaningless then
+         */
+        bool valid() const { return m_valid; }
+
+        /**
+         * @brief CR-RC^n pulse normalised to a peak of 1, at a time after the start of the pulse
+         */
+        double shape(double time) const;
+
+        /**
+         * @brief Asymmetry of the samples next to the peak sample, for the true peak at offset after it
+         */
+        double asymmetry(double offset) const;
+
+    private:
+        double m_samplingPeriod;
+        double m_shapingTime;
+        int m_order;
+        bool m_valid{false};
+
+        // Offset of the true peak from the peak sample at equally spaced asymmetry values
+        double m_asymmetryMin;
+        double m_asymmetryScale;
+        std::vector<double> m_offsetTable;
+
+        // Neighbour samples of the batch, one entry per strip
+        std::vector<float> m_before;
+        std::vector<float> m_after;
+        std::vector<float> m_position;
+    };
+
+} // namespace corryvreckan
+#endif // APV25PulseTiming_H
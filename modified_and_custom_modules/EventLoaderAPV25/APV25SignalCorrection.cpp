@@ -0,0 +1,137 @@
+/**
+ * @file
+ * @brief Implementation of the pedestal and common mode correction of EventLoaderAPV25
+ *
+ * @copyright Copyright (c) 2020 CERN and the Corryvreckan authors.
+ * This software is distributed under the terms of the MIT License, copied verbatim in the file "LICENSE.md".
+ * In applying this license, CERN does not waive the privileges and immunities granted to it by virtue of its status as an
+ * Intergovernmental Organization or submit itself to any jurisdiction.
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "APV25SignalCorrection.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace corryvreckan;
+
+APV25SignalCorrection::APV25SignalCorrection(CommonMode common_mode,
+                                             double trim_fraction,
+                                             size_t min_strips,
+                                             double zero_suppression_sigma)
+    : m_commonMode(common_mode), m_trimFraction(trim_fraction), m_minStrips(std::max<size_t>(min_strips, 1)),
+      m_zeroSuppressionSigma(zero_suppression_sigma) {}
+
+void APV25SignalCorrection::setPedestal(int plane, int strip, double pedestal, double noise) {
+    if(strip < 0) {
+        return;
+    }
+    auto index = static_cast<size_t>(strip);
+    auto& pedestals = m_pedestals[plane == 0 ? 0 : 1];
+    auto& thresholds = m_thresholds[plane == 0 ? 0 : 1];
+    if(pedestals.size() <= index) {
+        pedestals.resize(index + 1, 0);
+        thresholds.resize(index + 1, 0);
+    }
+    pedestals[index] = static_cast<int16_t>(std::lround(pedestal));
+    thresholds[index] = static_cast<float>(m_zeroSuppressionSigma * noise);
+    m_hasPedestals = true;
+}
+
+void APV25SignalCorrection::apply(APV25WaveformMatrix& waveforms,
+                                  const std::vector<int>& planes,
+                                  const std::vector<int>& strips,
+                                  std::vector<char>& keep) {
+    auto timebins = waveforms.timebins();
+    keep.assign(waveforms.rows(), 1);
+
+    if(m_hasPedestals) {
+        for(size_t row = 0; row < waveforms.rows(); row++) {
+            const auto& pedestals = m_pedestals[planes[row] == 0 ? 0 : 1];
+            auto strip = static_cast<size_t>(strips[row]);
+            if(strip >= pedestals.size()) {
+                continue;
+            }
+            int16_t* __restrict samples = waveforms.row(row);
+            int16_t pedestal = pedestals[strip];
+            for(size_t t = 0; t < timebins; t++) {
+                samples[t] = static_cast<int16_t>(samples[t] - pedestal);
+            }
+        }
+    }
+
+    if(m_commonMode != CommonMode::NONE) {
+        for(auto& rows : m_chipRows) {
+            rows.clear();
+        }
+        for(size_t row = 0; row < waveforms.rows(); row++) {
+            auto chip = static_cast<size_t>(std::max(strips[row], 0) / strips_per_chip * 2 + (planes[row] == 0 ? 0 : 1));
+            if(chip >= m_chipRows.size()) {
+                m_chipRows.resize(chip + 1);
+            }
+            m_chipRows[chip].push_back(row);
+        }
+        for(const auto& rows : m_chipRows) {
+            if(rows.size() >= m_minStrips) {
+                subtractCommonMode(waveforms, rows);
+            }
+        }
+    }
+
+    if(m_hasPedestals && m_zeroSuppressionSigma > 0) {
+        for(size_t row = 0; row < waveforms.rows(); row++) {
+            const auto& thresholds = m_thresholds[planes[row] == 0 ? 0 : 1];
+            auto strip = static_cast<size_t>(strips[row]);
+            if(strip < thresholds.size()) {
+                keep[row] = (waveforms.peak(row).amplitude > thresholds[strip]);
+            }
+        }
+    }
+}
+
+void APV25SignalCorrection::subtractCommonMode(APV25WaveformMatrix& waveforms, const std::vector<size_t>& rows) {
+    auto timebins = waveforms.timebins();
+
+    // One value per time bin from the samples of all strips of the chip
+    m_commonModes.resize(timebins);
+    for(size_t t = 0; t < timebins; t++) {
+        m_samples.clear();
+        for(auto row : rows) {
+            m_samples.push_back(waveforms.row(row)[t]);
+        }
+        m_commonModes[t] = commonMode(m_samples);
+    }
+
+    const int16_t* __restrict common_modes = m_commonModes.data();
+    for(auto row : rows) {
+        int16_t* __restrict samples = waveforms.row(row);
+        for(size_t t = 0; t < timebins; t++) {
+            samples[t] = static_cast<int16_t>(samples[t] - common_modes[t]);
+        }
+    }
+}
+
+int16_t APV25SignalCorrection::commonMode(std::vector<int16_t>& samples) const {
+    if(samples.empty()) {
+        return 0;
+    }
+
+    if(m_commonMode == CommonMode::MEDIAN) {
+        auto middle = samples.begin() + static_cast<std::ptrdiff_t>(samples.size() / 2);
+        std::nth_element(samples.begin(), middle, samples.end());
+        return *middle;
+    }
+
+    // Trimmed mean, the outer samples on both sides are dropped
+    std::sort(samples.begin(), samples.end());
+    auto cut = static_cast<size_t>(m_trimFraction * static_cast<double>(samples.size()));
+    if(2 * cut >= samples.size()) {
+        cut = (samples.size() - 1) / 2;
+    }
+    int sum = 0;
+    for(size_t i = cut; i < samples.size() - cut; i++) {
+        sum += samples[i];
+    }
+    return static_cast<int16_t>(std::lround(static_cast<double>(sum) / static_cast<double>(samples.size() - 2 * cut)));
+}
@@ -0,0 +1,96 @@
+/**
+ * @file
+ * @brief Definition of the pedestal and common mode correction of EventLoaderAPV25
+ *
+ * @copyright Copyright (c) 2020 CERN and the Corryvreckan authors.
+ * This software is distributed under the terms of the MIT License, copied verbatim in the file "LICENSE.md".
+ * In applying this license, CERN does not waive the privileges and immunities granted to it by virtue of its status as an
+ * Intergovernmental Organization or submit itself to any jurisdiction.
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef APV25SignalCorrection_H
+#define APV25SignalCorrection_H 1
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "APV25WaveformMatrix.h"
+
+namespace corryvreckan {
+    /**
+     * @brief Pedestal subtraction, common mode subtraction and zero suppression of the strip waveforms of one event
+     *
+     * The corrections are applied in place on the rows of the waveform matrix:
+     * - the pedestal of each strip is subtracted from all its samples
+     * - the common mode of each APV25 chip, 128 strips of one plane, is taken per time bin as the median or the trimmed
+     *   mean of the samples of its strips and subtracted from them. Chips with fewer strips in the event are left as they
+     *   are, the estimate from a few strips would be dominated by the signal.
+     * - strips whose peak is not above the given number of noise sigmas are marked as suppressed
+     * Without pedestals, only the common mode correction is done.
+     */
+    class APV25SignalCorrection {
+
+    public:
+        enum class CommonMode { NONE, MEDIAN, TRIMMED_MEAN };
+
+        /**
+         * @brief Constructor
+         * @param common_mode Estimator of the common mode
+         * @param trim_fraction Fraction of the samples cut on each side for the trimmed mean
+         * @param min_strips Least number of strips of a chip in the event to compute its common mode
+         * @param zero_suppression_sigma Threshold in noise sigmas of the zero suppression, 0 to switch it off
+         */
+        explicit APV25SignalCorrection(CommonMode common_mode = CommonMode::NONE,
+                                       double trim_fraction = 0.25,
+                                       size_t min_strips = 32,
+                                       double zero_suppression_sigma = 0);
+
+        /**
+         * @brief Set the pedestal and the noise of one strip, both in ADC counts
+         */
+        void setPedestal(int plane, int strip, double pedestal, double noise);
+
+        bool hasPedestals() const { return m_hasPedestals; }
+
+        /**
+         * @brief Correct the rows of the matrix
+         * @param waveforms Matrix with one row per strip
+         * @param planes Plane of each row
+         * @param strips Strip of each row
+         * @param keep Set to whether each row passes the zero suppression
+         */
+        void apply(APV25WaveformMatrix& waveforms,
+                   const std::vector<int>& planes,
+                   const std::vector<int>& strips,
+                   std::vector<char>& keep);
+
+        /**
+         * @brief Common mode of a set of samples, reorders them
+         */
+        int16_t commonMode(std::vector<int16_t>& samples) const;
+
+    private:
+        static constexpr int strips_per_chip = 128;
+
+        void subtractCommonMode(APV25WaveformMatrix& waveforms, const std::vector<size_t>& rows);
+
+        CommonMode m_commonMode;
+        double m_trimFraction;
+        size_t m_minStrips;
+        double m_zeroSuppressionSigma;
+
+        // Per plane, indexed by strip
+        bool m_hasPedestals{false};
+        std::vector<int16_t> m_pedestals[2];
+        std::vector<float> m_thresholds[2];
+
+        // Rows of each chip, indexed by plane * chips + chip, and the scratch buffers of the common mode
+        std::vector<std::vector<size_t>> m_chipRows;
+        std::vector<int16_t> m_samples;
+        std::vector<int16_t> m_commonModes;
+    };
+
+} // namespace corryvreckan
+#endif // APV25SignalCorrection_H
@@ -0,0 +1,67 @@
+/**
+ * @file
+ * @brief Implementation of the APV25 waveform matrix of EventLoaderAPV25
+ *
+ * @copyright Copyright (c) 2020 CERN and the Corryvreckan authors.
+ * This software is distributed under the terms of the MIT License, copied verbatim in the file "LICENSE.md".
+ * In applying this license, CERN does not waive the privileges and immunities granted to it by virtue of its status as an
+ * Intergovernmental Organization or submit itself to any jurisdiction.
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "APV25WaveformMatrix.h"
+
+#include <limits>
+
+using namespace corryvreckan;
+
+namespace {
+    // 16 samples of 16 bit, one AVX register
+    constexpr size_t row_alignment = 16;
+} // namespace
+
+APV25WaveformMatrix::APV25WaveformMatrix(size_t timebins)
+    : m_timebins(timebins), m_stride((timebins + row_alignment - 1) / row_alignment * row_alignment) {}
+
+void APV25WaveformMatrix::resize(size_t rows) {
+    m_rows = rows;
+    // Only grows, the padding of the rows is never read
+    if(m_samples.size() < rows * m_stride) {
+        m_samples.resize(rows * m_stride);
+    }
+}
+
+APV25WaveformMatrix::Peak APV25WaveformMatrix::peak(size_t index) const {
+    const int16_t* __restrict samples = row(index);
+
+    // Maximum as a reduction, then the first bin holding it
+    int16_t amplitude = std::numeric_limits<int16_t>::min();
+    for(size_t t = 0; t < m_timebins; t++) {
+        amplitude = samples[t] > amplitude ? samples[t] : amplitude;
+    }
+    int bin = 0;
+    while(samples[bin] != amplitude) {
+        bin++;
+    }
+    return {amplitude, bin};
+}
+
+int APV25WaveformMatrix::integral(size_t index) const {
+    const int16_t* __restrict samples = row(index);
+
+    int sum = 0;
+    for(size_t t = 0; t < m_timebins; t++) {
+        sum += samples[t];
+    }
+    return sum;
+}
+
+int APV25WaveformMatrix::timeOverThreshold(size_t index, int16_t threshold) const {
+    const int16_t* __restrict samples = row(index);
+
+    int count = 0;
+    for(size_t t = 0; t < m_timebins; t++) {
+        count += (samples[t] > threshold);
+    }
+    return count;
+}
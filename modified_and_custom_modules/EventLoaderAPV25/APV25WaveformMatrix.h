@@ -0,0 +1,90 @@
+/**
+ * @file
+ * @brief Definition of the APV25 waveform matrix of EventLoaderAPV25
+ *
+ * @copyright Copyright (c) 2020 CERN and the Corryvreckan authors.
+ * This software is distributed under the terms of the MIT License, copied verbatim in the file "LICENSE.md".
+ * In applying this license, CERN does not waive the privileges and immunities granted to it by virtue of its status as an
+ * Intergovernmental Organization or submit itself to any jurisdiction.
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef APV25WaveformMatrix_H
+#define APV25WaveformMatrix_H 1
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+namespace corryvreckan {
+    /**
+     * @brief Sampled waveforms of the hits of one event, one aligned row of ADC values per hit
+     *
+     * The rows are padded to a multiple of 32 bytes and the matrix starts on a 64 byte boundary, so every row starts on a
+     * vector register boundary. The feature kernels run over the time bins of one row in plain loops without branches,
+     * which the compiler turns into SIMD code.
+     */
+    class APV25WaveformMatrix {
+
+    public:
+        struct Peak {
+            int16_t amplitude;
+            int bin;
+        };
+
+        /**
+         * @brief Constructor
+         * @param timebins Number of samples per waveform
+         */
+        explicit APV25WaveformMatrix(size_t timebins = 15);
+
+        /**
+         * @brief Set the number of rows, the contents of the matrix are undefined afterwards
+         */
+        void resize(size_t rows);
+
+        int16_t* row(size_t index) { return m_samples.data() + index * m_stride; }
+        const int16_t* row(size_t index) const { return m_samples.data() + index * m_stride; }
+
+        size_t rows() const { return m_rows; }
+        size_t timebins() const { return m_timebins; }
+
+        /**
+         * @brief Highest sample of a row and its time bin, the first one if several are equal
+         */
+        Peak peak(size_t index) const;
+
+        /**
+         * @brief Sum of all samples of a row
+         */
+        int integral(size_t index) const;
+
+        /**
+         * @brief Number of time bins of a row with a sample above the threshold
+         */
+        int timeOverThreshold(size_t index, int16_t threshold) const;
+
+    private:
+        template <typename T, size_t Alignment> struct AlignedAllocator {
+            using value_type = T;
+            template <typename U> struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+            AlignedAllocator() = default;
+            template <typename U> AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+            T* allocate(size_t n) { return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment))); }
+            void deallocate(T* p, size_t) { ::operator delete(p, std::align_val_t(Alignment)); }
+
+            template <typename U> bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+            template <typename U> bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+        };
+
+        size_t m_timebins;
+        size_t m_stride;
+        size_t m_rows{0};
+        std::vector<int16_t, AlignedAllocator<int16_t, 64>> m_samples;
+    };
+
+} // namespace corryvreckan
+#endif // APV25WaveformMatrix_H
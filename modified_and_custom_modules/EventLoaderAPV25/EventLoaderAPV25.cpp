@@ -22,6 +22,8 @@
 #include <TTreeReaderValue.h>
 #include <TTreeReaderArray.h>
 
+#include <cmath>
+
 #include "objects/Object.hpp"
 #include "objects/objects.h"
 
@@ -34,189 +36,460 @@
 using namespace corryvreckan;
 
 EventLoaderAPV25::EventLoaderAPV25(Configuration& config, std::shared_ptr<Detector> detector)
-  : Module(config, detector), m_detector(detector) {
+  : Module(config, detector), m_detector(detector), async_input(config_) {
 
     m_inputFile = config_.get<std::string>("file_input");
+
+    config_.setDefault<bool>("object_pool", false);
+    pixel_factory = ObjectFactory<Pixel>(config_.get<bool>("object_pool"));
+    cluster_factory = ObjectFactory<Cluster>(config_.get<bool>("object_pool"));
+
+    config_.setDefault<bool>("make_clusters", false);
+    m_makeClusters = config_.get<bool>("make_clusters");
+    m_detectorName = m_detector->getName();
+
+    config_.setDefault<int>("trace_sample_interval", 1000);
+    hit_trace = HotPathTracer(config_.get<int>("trace_sample_interval"));
+
+    config_.setDefault<int>("number_of_timebins", 15);
+    config_.setDefault<int>("tot_threshold", 50);
+    m_timebins = config_.get<int>("number_of_timebins");
+    if (m_timebins < 1){
+      throw InvalidValueError(config_, "number_of_timebins", "at least one time bin is needed");
+    }
+    m_totThreshold = static_cast<int16_t>(config_.get<int>("tot_threshold"));
 	}
 
 EventLoaderAPV25::~EventLoaderAPV25(){
+	delete TempPlaneClusterHistogram;
 }
 
 void EventLoaderAPV25::initialize() {
 
+	geometry = DetectorGeometryCache(m_detector);
 
 	std::string title = m_detector->getName() + "x_cluster_max_adc_full_waveform;ADC_timebin; ADC_counts";
-	maxHitWaveform_x = new TH1F("maxHitWaveform_x", title.c_str(), 20, 0, 20);
+	maxHitWaveform_x = new TH1F("maxHitWaveform_x", title.c_str(), m_timebins, 0, m_timebins);
 
 	title = m_detector->getName() + "y_cluster_max_adc_full_waveform;ADC_timebin; ADC_counts";
-	maxHitWaveform_y = new TH1F("maxHitWaveform_y", title.c_str(), 20, 0, 20);
+	maxHitWaveform_y = new TH1F("maxHitWaveform_y", title.c_str(), m_timebins, 0, m_timebins);
+
+	title = m_detector->getName() + " strip peak time bin;ADC_timebin;strips";
+	peakTimebin = new TH1F("peakTimebin", title.c_str(), m_timebins, 0, m_timebins);
+
+	title = m_detector->getName() + " strip waveform integral;ADC_counts;strips";
+	waveformIntegral = new TH1F("waveformIntegral", title.c_str(), 500, 0, 500 * m_timebins);
+
+	title = m_detector->getName() + " strip time over threshold;ADC_timebins;strips";
+	timeOverThreshold = new TH1F("timeOverThreshold", title.c_str(), m_timebins + 1, 0, m_timebins + 1);
+
+	// Events with more clusters on a plane are skipped, the X/Y matching itself scales polynomially
+	config_.setDefault<int>("max_plane_clusters", 4);
+	m_maxPlaneClusters = config_.get<int>("max_plane_clusters");
 
-	data_file = TFile::Open(m_inputFile.c_str());
-	if (!data_file || data_file->IsZombie()){
-		LOG(DEBUG) << "Failed to open the data file: " << m_inputFile;
-		throw ModuleError("Error in opening TFile");
+	// Position of the plane clusters, fit is the Gaussian fit of a histogram kept as reference
+	config_.setDefault<std::string>("position_estimator", "centroid");
+	auto estimator = config_.get<std::string>("position_estimator");
+	m_fitPosition = (estimator == "fit");
+	if (m_fitPosition){
+		// Only used as fit input, kept out of the output file
+		TempPlaneClusterHistogram = new TH1F("PlaneCluster", "strip", 256, 0, 256);
+		TempPlaneClusterHistogram->SetDirectory(nullptr);
 	}
+	else if (estimator == "centroid"){
+		cluster_position = APV25ClusterPosition(APV25ClusterPosition::Estimator::CENTROID);
+	}
+	else if (estimator == "gaussian3"){
+		cluster_position = APV25ClusterPosition(APV25ClusterPosition::Estimator::GAUSSIAN3);
+	}
+	else if (estimator == "eta"){
+		std::vector<double> eta_correction;
+		if (config_.has("eta_correction")){
+			eta_correction = config_.getArray<double>("eta_correction");
+		}
+		cluster_position = APV25ClusterPosition(APV25ClusterPosition::Estimator::ETA, eta_correction);
 
-	data_tree = dynamic_cast<TTree*>(data_file->Get("THit"));
-	if (!data_tree) {
-			LOG(ERROR) << "Failed to retrieve TTree 'hits' from file";
-			throw ModuleError("Failed to retrieve TTree 'cluster_detector'");
+		title = m_detector->getName() + " X plane cluster eta;#eta;clusters";
+		etaDistribution_x = new TH1F("etaDistribution_x", title.c_str(), 100, 0, 1);
+		title = m_detector->getName() + " Y plane cluster eta;#eta;clusters";
+		etaDistribution_y = new TH1F("etaDistribution_y", title.c_str(), 100, 0, 1);
+	}
+	else {
+		throw InvalidValueError(config_, "position_estimator", "expected fit, centroid, gaussian3 or eta");
 	}
 
-	reader = new TTreeReader("THit", data_file);
+	// Detector ID in the THit TTree, from the channel_map or the GEMXY<n> names starting from 0
+	detectorID = ChannelMap(config_, 0).get(m_detector->getName()).det_id;
+
+	// Pedestal, common mode and zero suppression of the strip waveforms before clustering
+	config_.setDefault<std::string>("common_mode", "none");
+	config_.setDefault<double>("common_mode_trim_fraction", 0.25);
+	config_.setDefault<int>("common_mode_min_strips", 32);
+	config_.setDefault<double>("zero_suppression_sigma", 5);
+	auto common_mode = config_.get<std::string>("common_mode");
+	APV25SignalCorrection::CommonMode common_mode_estimator;
+	if (common_mode == "none"){
+		common_mode_estimator = APV25SignalCorrection::CommonMode::NONE;
+	}
+	else if (common_mode == "median"){
+		common_mode_estimator = APV25SignalCorrection::CommonMode::MEDIAN;
+	}
+	else if (common_mode == "trimmed_mean"){
+		common_mode_estimator = APV25SignalCorrection::CommonMode::TRIMMED_MEAN;
+	}
+	else {
+		throw InvalidValueError(config_, "common_mode", "expected none, median or trimmed_mean");
+	}
+	auto trim_fraction = config_.get<double>("common_mode_trim_fraction");
+	if (trim_fraction < 0 || trim_fraction >= 0.5){
+		throw InvalidValueError(config_, "common_mode_trim_fraction", "has to be in [0, 0.5)");
+	}
+	signal_correction = APV25SignalCorrection(common_mode_estimator,
+	                                          trim_fraction,
+	                                          static_cast<size_t>(std::max(config_.get<int>("common_mode_min_strips"), 1)),
+	                                          config_.get<double>("zero_suppression_sigma"));
+	if (config_.has("pedestal_file")){
+		LoadPedestals(config_.getPath("pedestal_file", true));
+	}
+	m_correctSignals = signal_correction.hasPedestals() || common_mode_estimator != APV25SignalCorrection::CommonMode::NONE;
+
+	// Pixel time, either the event ID or the event placed on a time axis plus the time of the pulses
+	config_.setDefault<std::string>("pixel_time", "event_id");
+	config_.setDefault<double>("sampling_period", Units::get<double>(25, "ns"));
+	config_.setDefault<double>("shaping_time", Units::get<double>(50, "ns"));
+	config_.setDefault<int>("shaping_order", 1);
+	auto pixel_time = config_.get<std::string>("pixel_time");
+	if (pixel_time == "pulse_shape"){
+		m_pulseTiming = true;
+	}
+	else if (pixel_time == "event_id"){
+		m_pulseTiming = false;
+	}
+	else {
+		throw InvalidValueError(config_, "pixel_time", "expected event_id or pulse_shape");
+	}
+	if (m_pulseTiming){
+		auto sampling_period = config_.get<double>("sampling_period");
+		auto shaping_time = config_.get<double>("shaping_time");
+		auto shaping_order = config_.get<int>("shaping_order");
+		if (!(sampling_period > 0)){
+			throw InvalidValueError(config_, "sampling_period", "has to be positive");
+		}
+		if (!(shaping_time > 0)){
+			throw InvalidValueError(config_, "shaping_time", "has to be positive");
+		}
+		if (shaping_order < 1){
+			throw InvalidValueError(config_, "shaping_order", "has to be at least 1");
+		}
+
+		// The neighbours of the peak sample only carry the timing if the pulse spans a few samples: with a peaking
+		// time below the sampling period their asymmetry saturates and the times are off by up to a sampling period
+		auto peaking_time = shaping_order * shaping_time;
+		if (peaking_time < sampling_period){
+			throw InvalidValueError(config_, "shaping_time", "the peaking time shaping_order * shaping_time is shorter than the sampling_period, the pulse timing cannot resolve it");
+		}
+		if (peaking_time < 2 * sampling_period){
+			LOG(WARNING) << "The peaking time shaping_order * shaping_time of " << m_detector->getName() << " is below two sampling periods, the pulse start times lose precision";
+		}
 
-  evtID = new TTreeReaderValue<int>(*reader, "evtID");
-	nch = new TTreeReaderValue<int>(*reader, "nch");
+		config_.setDefault<double>("event_length", m_timebins * sampling_period);
+		m_eventLength = config_.get<double>("event_length");
+		pulse_timing = APV25PulseTiming(sampling_period, shaping_time, shaping_order);
+		if (!pulse_timing.valid()){
+			throw InvalidValueError(config_, "shaping_time", "the pulse shape leaves no usable range of peak positions for the sampling_period");
+		}
 
+		title = m_detector->getName() + " strip pulse start time;t_{0} [ns];strips";
+		auto time_range = static_cast<double>(Units::convert(m_eventLength, "ns"));
+		stripTime = new TH1F("stripTime", title.c_str(), 200, -time_range, time_range);
+		title = m_detector->getName() + " X - Y cluster time;t_{X} - t_{Y} [ns];clusters";
+		clusterTimeDifference = new TH1F("clusterTimeDifference", title.c_str(), 200, -100, 100);
+	}
+
+	// Clusters of a previous run with the same input and settings are read from the cache, otherwise they are written to it
+	if (config_.has("cluster_cache")){
+		auto cache_path = config_.getPath("cluster_cache");
+		auto cache_key = APV25ClusterCache::key(m_inputFile, CacheSettings());
+		if (cache_key == 0){
+			throw ModuleError("Cannot read the input file " + m_inputFile);
+		}
+		m_readCache = cluster_cache.open(cache_path, cache_key);
+		if (m_readCache){
+			LOG(INFO) << "Reading the clusters of " << cluster_cache.events() << " events of " << m_detector->getName() << " from " << cache_path;
+		}
+		else if (cluster_cache.create(cache_path, cache_key)){
+			LOG(INFO) << "No valid cluster cache at " << cache_path << ", writing it for " << m_detector->getName();
+		}
+		else {
+			LOG(WARNING) << "Cannot write the cluster cache " << cache_path;
+		}
+	}
+
+	// All detectors reading the same file share one reader, each THit entry is read only once. The THit entries are
+	// read in batches of the same size for all of them, reconstructed in parallel or one event at a time.
+	config_.setDefault<int>("event_batch_size", 256);
+	if (config_.get<int>("event_batch_size") < 1){
+		throw InvalidValueError(config_, "event_batch_size", "at least one event per batch is needed");
+	}
+	m_batchSize = static_cast<size_t>(config_.get<int>("event_batch_size"));
+	if (!m_readCache){
+		hit_reader = APV25HitDemultiplexer::getInstance(m_inputFile, m_timebins, async_input, m_batchSize);
+		hit_reader->registerDetector(detectorID);
+	}
+
+	// The events of a batch are reconstructed in parallel, the Pixels still go to the clipboard event by event
+	config_.setDefault<int>("worker_threads", 0);
+	auto worker_threads = config_.get<int>("worker_threads");
+	if (worker_threads < 0){
+		throw InvalidValueError(config_, "worker_threads", "cannot be negative");
+	}
+	if (worker_threads > 0 && m_fitPosition){
+		throw InvalidValueError(config_, "worker_threads", "position_estimator = fit uses ROOT fits and only runs single-threaded");
+	}
+	if (worker_threads > 0 && !m_readCache){
+		worker_pool = std::make_unique<WorkerPool>(static_cast<size_t>(worker_threads));
+	}
+
+	// The workers fill their own copies of the histograms, merged in finalize
+	workspaces.resize(worker_pool ? worker_pool->size() : 1);
+	for (size_t w=0; w<workspaces.size(); w++){
+		auto &ws = workspaces[w];
+		ws.signal_correction = signal_correction;
+		ws.pulse_timing = pulse_timing;
+		ws.hit_trace = hit_trace;
+		ws.Hits_Plane_X.reserve(static_cast<size_t>(m_detector->nPixels().X()));
+		ws.Hits_Plane_Y.reserve(static_cast<size_t>(m_detector->nPixels().Y()));
+
+		auto shard = [w](TH1F* histogram) -> TH1F* {
+			if (w == 0 || !histogram) return histogram;
+			auto copy = static_cast<TH1F*>(histogram->Clone((std::string(histogram->GetName()) + "_worker" + std::to_string(w)).c_str()));
+			copy->SetDirectory(nullptr);
+			return copy;
+		};
+		ws.maxHitWaveform_x = shard(maxHitWaveform_x);
+		ws.maxHitWaveform_y = shard(maxHitWaveform_y);
+		ws.peakTimebin = shard(peakTimebin);
+		ws.waveformIntegral = shard(waveformIntegral);
+		ws.timeOverThreshold = shard(timeOverThreshold);
+		ws.etaDistribution_x = shard(etaDistribution_x);
+		ws.etaDistribution_y = shard(etaDistribution_y);
+		ws.stripTime = shard(stripTime);
+		ws.clusterTimeDifference = shard(clusterTimeDifference);
+	}
 
-	// Peak adc bin number == hitTimebin
-	hitTimebin = new TTreeReaderArray<int>(*reader, "hitTimebin.hitTimeBin");
-	
-  planeID = new TTreeReaderArray<int>(*reader, "planeID");
-	strip = new TTreeReaderArray<int>(*reader, "strip");	
-	detID = new TTreeReaderArray<int>(*reader, "detID");
-
-
-	adcs = new std::vector<TTreeReaderArray<int16_t>*> {
-		new TTreeReaderArray<int16_t>(*reader, "adc0"),
-		new TTreeReaderArray<int16_t>(*reader, "adc1"),
-		new TTreeReaderArray<int16_t>(*reader, "adc2"),
-		new TTreeReaderArray<int16_t>(*reader, "adc3"),
-		new TTreeReaderArray<int16_t>(*reader, "adc4"),
-		new TTreeReaderArray<int16_t>(*reader, "adc5"),
-		new TTreeReaderArray<int16_t>(*reader, "adc6"),
-		new TTreeReaderArray<int16_t>(*reader, "adc7"),
-		new TTreeReaderArray<int16_t>(*reader, "adc8"),
-		new TTreeReaderArray<int16_t>(*reader, "adc9"),
-		new TTreeReaderArray<int16_t>(*reader, "adc10"),
-		new TTreeReaderArray<int16_t>(*reader, "adc11"),
-		new TTreeReaderArray<int16_t>(*reader, "adc12"),
-		new TTreeReaderArray<int16_t>(*reader, "adc13"),
-		new TTreeReaderArray<int16_t>(*reader, "adc14")
-			};
-
-/*	
-		adc2 = new TTreeReaderArray<uint16_t>(*reader, "adc2");
-		adc3 = new TTreeReaderArray<uint16_t>(*reader, "adc3");
-		adc4 = new TTreeReaderArray<uint16_t>(*reader, "adc4");
-		adc5 = new TTreeReaderArray<uint16_t>(*reader, "adc5");
-		adc6 = new TTreeReaderArray<uint16_t>(*reader, "adc6");
-		adc7 = new TTreeReaderArray<uint16_t>(*reader, "adc7");
-		adc8 = new TTreeReaderArray<uint16_t>(*reader, "adc8");
-		adc9 = new TTreeReaderArray<uint16_t>(*reader, "adc9");
-		adc10 = new TTreeReaderArray<uint16_t>(*reader, "adc10");
-		adc11 = new TTreeReaderArray<uint16_t>(*reader, "adc11");
-		adc12 = new TTreeReaderArray<uint16_t>(*reader, "adc12");
-		adc13 = new TTreeReaderArray<uint16_t>(*reader, "adc13");
-		adc14 = new TTreeReaderArray<uint16_t>(*reader, "adc14");
-		adc15 = new TTreeReaderArray<uint16_t>(*reader, "adc15");
-		adc16 = new TTreeReaderArray<uint16_t>(*reader, "adc16");
-		adc17 = new TTreeReaderArray<uint16_t>(*reader, "adc17");
-		adc18 = new TTreeReaderArray<uint16_t>(*reader, "adc18");
-		adc19 = new TTreeReaderArray<uint16_t>(*reader, "adc19");
-		adc20 = new TTreeReaderArray<uint16_t>(*reader, "adc20");
-		adc21 = new TTreeReaderArray<uint16_t>(*reader, "adc21");
-		adc22 = new TTreeReaderArray<uint16_t>(*reader, "adc22");
-		adc23 = new TTreeReaderArray<uint16_t>(*reader, "adc23");
-		adc24 = new TTreeReaderArray<uint16_t>(*reader, "adc24");
-		adc25 = new TTreeReaderArray<uint16_t>(*reader, "adc25");
-		adc26 = new TTreeReaderArray<uint16_t>(*reader, "adc26");
-		adc27 = new TTreeReaderArray<uint16_t>(*reader, "adc27");
-		adc28 = new TTreeReaderArray<uint16_t>(*reader, "adc28");
-		adc29 = new TTreeReaderArray<uint16_t>(*reader, "adc29");
-*/
 	/// Initialise member variables
   m_eventNumber = 0;
-	number_of_entries = data_tree->GetEntries();
 		
 }
 
 StatusCode EventLoaderAPV25::run(const std::shared_ptr<Clipboard>& clipboard) {
 
-  reader->SetLocalEntry(m_eventNumber);
+  // Matched clusters straight from the mapped cache, no reconstruction
+  if (m_readCache){
+    if (static_cast<size_t>(m_eventNumber) >= cluster_cache.events()) return StatusCode::EndRun;
+
+    cache_hits.clear();
+    for (auto record = cluster_cache.begin(m_eventNumber); record != cluster_cache.end(m_eventNumber); ++record){
+      cache_hits.push_back({record->column, record->row, record->charge, record->time});
+    }
+    StoreHits(cache_hits.data(), cache_hits.data() + cache_hits.size(), clipboard);
+    m_eventNumber++;
+
+    if (static_cast<size_t>(m_eventNumber) == cluster_cache.events()) return StatusCode::EndRun;
+    return StatusCode::Success;
+  }
+
+  // Read the next batch of events once the last one is used up, the workers reconstruct all of it at once
+  if (m_batchNext >= batch_pixels.size()){
+    // The first detector of the batch reads the THit entries for all detectors
+    auto loaded = hit_reader->loadBatch(m_eventNumber);
+    if (loaded == 0){
+      m_inputComplete = true;
+      return StatusCode::EndRun;
+    }
+
+    batch_pixels.resize(loaded);
+    if (worker_pool){
+      worker_pool->forEach(loaded, [&](size_t event, size_t worker){
+        ReconstructEvent(workspaces[worker], hit_reader->getHits(detectorID, event), hit_reader->getEventID(event), batch_pixels[event]);
+      });
+    }
+    m_batchNext = 0;
+  }
+
+  // Without workers the events of the batch are reconstructed one at a time, as they are used
+  if (!worker_pool){
+    ReconstructEvent(workspaces[0], hit_reader->getHits(detectorID, m_batchNext), hit_reader->getEventID(m_batchNext), batch_pixels[m_batchNext]);
+  }
 
   LOG(DEBUG) << "evt Corryvreckan___: " << m_eventNumber;
 
-  PixelVector pixel_container;
+  // The matched clusters are put on the clipboard in the order of the events
+  const auto &hits = batch_pixels[m_batchNext];
+  if (cluster_cache.writing()){
+    cache_records.clear();
+    for (const auto &hit : hits){
+      cache_records.push_back({hit.column, hit.row, hit.charge, 0, hit.time});
+    }
+    cluster_cache.write(cache_records);
+  }
+  StoreHits(hits.data(), hits.data() + hits.size(), clipboard);
+  m_batchNext++;
 
-	// Configure detectors according to your detectors file!
-	if(strcmp(m_detector->getName().c_str(), "GEMXY1")==0) detectorID = 0 ;
-	if(strcmp(m_detector->getName().c_str(), "GEMXY2")==0) detectorID = 1 ;
-	if(strcmp(m_detector->getName().c_str(), "GEMXY3")==0) detectorID = 2 ;
+	m_eventNumber++;
 
+	LOG(DEBUG) << "===========================================================================" << std::endl;
 
-	// Hits_Plane_N < strip, peak_adc >
-	Hits_Plane_X.clear();
-	Hits_Plane_Y.clear();
+  // Return value telling analysis to keep running
+  if(hit_reader->getEntries()==m_eventNumber){
+    m_inputComplete = true;
+    return StatusCode::EndRun;
+  }
+  return StatusCode::Success;
+}
 
-	Clusters_Plane_X.clear();
-	Clusters_Plane_Y.clear();
+void EventLoaderAPV25::StoreHits(const PixelHit* begin, const PixelHit* end, const std::shared_ptr<Clipboard>& clipboard){
 
-	for (size_t i=0; i<**nch; i++){
-		if (detID->At(i) == detectorID){
-			if (planeID->At(i) == 0){
-				Hits_Plane_X.emplace_back(strip->At(i), adcs->at(static_cast<size_t>(hitTimebin->At(i) - 1))->At(i), i);
-				LOG(DEBUG) << "X strip" << strip->At(i) << ",   peak adc = " << adcs->at(static_cast<size_t>(hitTimebin->At(i) - 1))->At(i);
-			}
-			else  { // Y plane
-				Hits_Plane_Y.emplace_back(strip->At(i), adcs->at(static_cast<size_t>(hitTimebin->At(i) - 1))->At(i), i);
-				LOG(DEBUG) << "Y strip" << strip->At(i) << ",   peak adc = " << adcs->at(static_cast<size_t>(hitTimebin->At(i) - 1))->At(i);
-			}
+  // Putting data to the clipboard, if empty and empty vector will be filled
+  if (!m_makeClusters){
+    // Pixel args:
+    //  	=  [detector_name, strip_x (col), strip_y (row), raw (set to 1 if not known), sumALLADCs (charge), evtID (time)]
+    // The Pixels only hold whole strips, the positions are rounded to the nearest one
+    PixelVector pixel_container;
+    for (auto hit = begin; hit != end; ++hit){
+      auto pixel = pixel_factory.make(m_detectorName, static_cast<int>(std::lround(hit->column)), static_cast<int>(std::lround(hit->row)), 1, hit->charge, hit->time);
+      HOT_PATH_TRACE(hit_trace, "pixel", "col", hit->column, "row", hit->row, "charge", hit->charge, "time", hit->time);
+      pixel_container.push_back(pixel);
+    }
+    clipboard->putData(pixel_container, m_detector->getName());
+    return;
+  }
+
+  // The positions of all clusters of the event are transformed at once
+  local_x.clear();
+  local_y.clear();
+  for (auto hit = begin; hit != end; ++hit){
+    auto positionLocal = geometry.getLocalPosition(hit->column, hit->row);
+    local_x.push_back(positionLocal.x());
+    local_y.push_back(positionLocal.y());
+  }
+  geometry.localToGlobal(local_x, local_y, global_x, global_y, global_z);
+
+  ClusterVector cluster_container;
+  size_t i = 0;
+  for (auto hit = begin; hit != end; ++hit, ++i){
+    auto cluster = cluster_factory.make();
+    cluster->setColumn(hit->column);
+    cluster->setRow(hit->row);
+    cluster->setCharge(hit->charge);
+    cluster->setTimestamp(hit->time);
+    cluster->setDetectorID(m_detectorName);
+    cluster->setSplit(false);
+
+    cluster->setClusterCentreLocal(ROOT::Math::XYZPoint(local_x[i], local_y[i], 0));
+    cluster->setClusterCentre(ROOT::Math::XYZPoint(global_x[i], global_y[i], global_z[i]));
+    cluster->setError(geometry.getSpatialResolution(hit->column, hit->row));
+    cluster->setErrorMatrixGlobal(geometry.getSpatialResolutionMatrixGlobal(hit->column, hit->row));
+    HOT_PATH_TRACE(hit_trace, "cluster", "col", hit->column, "row", hit->row, "charge", hit->charge, "time", hit->time);
+    cluster_container.push_back(cluster);
+  }
+  clipboard->putData(cluster_container, m_detector->getName());
+}
+
+void EventLoaderAPV25::ReconstructEvent(EventWorkspace &ws, APV25HitDemultiplexer::DetectorHits &hits, int eventID, std::vector<PixelHit> &pixels){
+
+	pixels.clear();
+
+	// Hits_Plane_N < strip, peak_adc, waveform row >
+	ws.Hits_Plane_X.clear();
+	ws.Hits_Plane_Y.clear();
+
+	ws.Clusters_Plane_X.clear();
+	ws.Clusters_Plane_Y.clear();
+	ws.Cluster_Times_X.clear();
+	ws.Cluster_Times_Y.clear();
+	ws.timing_rows.clear();
+	ws.timing_bins.clear();
+
+	// Hits of this detector, row i of the waveform matrix is strip hit_strips[i] of plane hit_planes[i]
+	ws.hits = &hits;
+	auto &waveforms = hits.waveforms;
+	const auto &hit_planes = hits.planes;
+	const auto &hit_strips = hits.strips;
+
+	// Strips in the noise are dropped here, before they can make or grow clusters
+	if (m_correctSignals){
+		ws.signal_correction.apply(waveforms, hit_planes, hit_strips, ws.strip_kept);
+	}
+	else {
+		ws.strip_kept.assign(hit_strips.size(), 1);
+	}
+
+	for (size_t row=0; row<hit_strips.size(); row++){
+		if (!ws.strip_kept[row]){
+			ws.suppressed_strips++;
+			continue;
 		}
-	} // for(nch) 
-
-	std::sort(begin(Hits_Plane_X), end(Hits_Plane_X),
-					[](const std::tuple<int16_t, int16_t, int8_t> &t1, const std::tuple<int16_t, int16_t, int8_t> &t2) {
-						return std::get<0>(t1) < std::get<0>(t2) ||
-									 (std::get<0>(t1) == std::get<0>(t2) &&
-										std::get<1>(t1) > std::get<1>(t2));
-					});
-	
-	std::sort(begin(Hits_Plane_Y), end(Hits_Plane_Y),
-					[](const std::tuple<int16_t, int16_t, int8_t> &t1, const std::tuple<int16_t, int16_t, int8_t> &t2) {
-						return std::get<0>(t1) < std::get<0>(t2) ||
-									 (std::get<0>(t1) == std::get<0>(t2) &&
-										std::get<1>(t1) > std::get<1>(t2));
-					});
-
-	bool res = MakePlaneClusters(Hits_Plane_X, 0);
+		auto peak = waveforms.peak(row);
+		auto tot = waveforms.timeOverThreshold(row, m_totThreshold);
+		auto integral = waveforms.integral(row);
+		ws.peakTimebin->Fill(peak.bin);
+		ws.waveformIntegral->Fill(integral);
+		ws.timeOverThreshold->Fill(tot);
+		if (m_pulseTiming){
+			ws.timing_rows.push_back(row);
+			ws.timing_bins.push_back(peak.bin);
+		}
+
+		if (hit_planes[row] == 0){
+			ws.Hits_Plane_X.add(hit_strips[row], peak.amplitude, static_cast<int32_t>(row));
+			HOT_PATH_TRACE(ws.hit_trace, "X strip", "strip", hit_strips[row], "peak_adc", peak.amplitude, "peak_bin", peak.bin, "integral", integral, "tot", tot);
+		}
+		else  { // Y plane
+			ws.Hits_Plane_Y.add(hit_strips[row], peak.amplitude, static_cast<int32_t>(row));
+			HOT_PATH_TRACE(ws.hit_trace, "Y strip", "strip", hit_strips[row], "peak_adc", peak.amplitude, "peak_bin", peak.bin, "integral", integral, "tot", tot);
+		}
+	}
+
+	// Time of the pulses of all strips in one batch, kept per row of the matrix
+	if (m_pulseTiming){
+		ws.pulse_timing.estimate(waveforms, ws.timing_rows, ws.timing_bins, ws.timing_results);
+		ws.strip_times.assign(hit_strips.size(), 0);
+		for (size_t k=0; k<ws.timing_rows.size(); k++){
+			ws.strip_times[ws.timing_rows[k]] = ws.timing_results[k];
+			ws.stripTime->Fill(static_cast<double>(Units::convert(ws.timing_results[k], "ns")));
+		}
+	}
+
+	// Counting sort on the strip numbers, the buffers keep their storage between events
+	ws.Hits_Plane_X.sort();
+	ws.Hits_Plane_Y.sort();
+
+	bool res = MakePlaneClusters(ws, ws.Hits_Plane_X, 0);
 	
 
 	if (res)  {
-		bool res2 = MakePlaneClusters(Hits_Plane_Y, 1);
+		bool res2 = MakePlaneClusters(ws, ws.Hits_Plane_Y, 1);
 
 		if (res2){
-			LOG(DEBUG) << "was here1";
-			int bestPairsIndex = MatchPlaneClusters(Clusters_Plane_X, Clusters_Plane_Y);
+			MatchPlaneClusters(ws);
 		
-			for (auto &xyClust : allClusters[bestPairsIndex]){
-				// Pixel args:
-				//  	=  [detector_name, strip_x (col), strip_y (row), raw (set to 1 if not known), sumALLADCs (charge), evtID (time)]
-
-				auto pixel = std::make_shared<Pixel>(m_detector->getName().c_str(), std::get<0>(xyClust), std::get<1>(xyClust), 1, std::get<2>(xyClust), **evtID);
-				LOG(DEBUG) << "Made Pixel:  " << std::get<0>(xyClust) << ",  " << std::get<1>(xyClust) << ",  1,  " << std::get<2>(xyClust) << ",  "<< **evtID;
-				pixel_container.push_back(pixel);
+			for (size_t k=0; k<ws.curXYclusters.size(); k++){
+				auto &xyClust = ws.curXYclusters[k];
+				// With pulse_shape timing the time is evtID * event_length + mean pulse start time of the X and Y clusters
+				double time = m_pulseTiming ? eventID * m_eventLength + ws.XY_Times[k] : eventID;
+				pixels.push_back({std::get<0>(xyClust), std::get<1>(xyClust), std::get<2>(xyClust), time});
 			}
 		}
 	}
-
-	m_eventNumber++;
-
-  // Putting data to the clipboard, if empty and empty vector will be filled
-  clipboard->putData(pixel_container, m_detector->getName());
-
-	LOG(DEBUG) << "===========================================================================" << std::endl;
-
-  // Return value telling analysis to keep running
-  if(reader->GetEntries()==m_eventNumber) return StatusCode::EndRun;
-  return StatusCode::Success;
 }
 
-bool EventLoaderAPV25::MakePlaneClusters(std::vector<std::tuple<int16_t, int16_t, int8_t>> &hitsPlane, int which_plane){
+bool EventLoaderAPV25::MakePlaneClusters(EventWorkspace &ws, const APV25PlaneHits &hitsPlane, int which_plane){
 
-	// No pedestal value --> 1-2 ADC count error in charge!
+	// Without a pedestal_file the ADC values are not pedestal subtracted --> 1-2 ADC count error in charge!
 	
-	TempPlaneClusterHistogram = new TH1F("PlaneCluster", "strip", 256, 0, 256);
+	ws.cluster_strips.clear();
+	ws.cluster_adcs.clear();
 	int lastStrip=-1;
 	int maxAdc=-9999;
 	int sumAdcs=0;
@@ -224,51 +497,41 @@ bool EventLoaderAPV25::MakePlaneClusters(std::vector<std::tuple<int16_t, int16_t
 	int currentAdc = -9999;
 	int hitsCount=0;
 	int clusterCount = 0;
-	size_t maxIndex;
+	size_t maxIndex = 0;
 
 
-	for (auto &hits : hitsPlane){
-		currentStrip = std::get<0>(hits);
-		currentAdc = std::get<1>(hits);
+	for (size_t hit=0; hit<hitsPlane.size(); hit++){
+		currentStrip = hitsPlane.strip(hit);
+		currentAdc = hitsPlane.adc(hit);
 		
 		if (lastStrip ==-1 || currentStrip - lastStrip == 1){
-			TempPlaneClusterHistogram->Fill(currentStrip, currentAdc);
+			ws.cluster_strips.push_back(currentStrip);
+			ws.cluster_adcs.push_back(currentAdc);
 			if (currentAdc > maxAdc) {
 				maxAdc = currentAdc;
-				maxIndex = std::get<2>(hits);
+				maxIndex = hitsPlane.row(hit);
 			}
 			sumAdcs += currentAdc;
 			hitsCount++;
-			LOG(DEBUG) << "currentStrip = " << currentStrip <<  ",   currentAdcs = " << currentAdc;
+			HOT_PATH_TRACE(ws.hit_trace, "cluster strip", "strip", currentStrip, "adc", currentAdc);
 		}
 		else {
 			
 			if (hitsCount >= 2){
-				TempPlaneClusterHistogram->Fit("gaus", "q");
-				LOG(DEBUG) << "Histo gaus mean = " <<  TempPlaneClusterHistogram->GetFunction("gaus")->GetParameter(1) ;
+				double position = PlaneClusterPosition(ws, which_plane);
 				
-				// Cluster_Plane < strip, sumAdcs, cluster_size >
+				// Cluster_Plane < strip position, sumAdcs, cluster_size >
 				if (which_plane==0) { // X plane
-					Clusters_Plane_X.emplace_back(TempPlaneClusterHistogram->GetFunction("gaus")->GetParameter(1), sumAdcs, hitsCount);
+					ws.Clusters_Plane_X.emplace_back(position, sumAdcs, hitsCount);
+					ws.Cluster_Times_X.push_back(ClusterTime(ws, maxIndex));
 					
-					for (int i=0; i<14; i++){
-            // negative values not filled
-            if (adcs->at(i)->At(maxIndex) > 0) {
-              LOG(DEBUG) << "adcs->at(maxIndex)->At(" << i <<") = " << adcs->at(i)->At(maxIndex);
-              maxHitWaveform_x->Fill(i, adcs->at(i)->At(maxIndex));
-              }
-            }				
+					FillMaxHitWaveform(ws, maxIndex, which_plane);
 				}
 				else if (which_plane==1) { // Y plane
-					Clusters_Plane_Y.emplace_back(TempPlaneClusterHistogram->GetFunction("gaus")->GetParameter(1), sumAdcs, hitsCount);
+					ws.Clusters_Plane_Y.emplace_back(position, sumAdcs, hitsCount);
+					ws.Cluster_Times_Y.push_back(ClusterTime(ws, maxIndex));
 					
-					for (int i=0; i<14; i++){
-            // negative values not filled
-            if (adcs->at(i)->At(maxIndex) > 0) {
-              LOG(DEBUG) << "adcs->at(maxIndex)->At(" << i <<") = " << adcs->at(i)->At(maxIndex);
-              maxHitWaveform_y->Fill(i, adcs->at(i)->At(maxIndex));
-              }
-            }				
+					FillMaxHitWaveform(ws, maxIndex, which_plane);
 				}
           
 
@@ -276,13 +539,14 @@ bool EventLoaderAPV25::MakePlaneClusters(std::vector<std::tuple<int16_t, int16_t
 				clusterCount++;
 				}
 
-			// Reset the clusterization. Hits to 1, histogram reseted and filled with
+			// Reset the clusterization. Hits to 1, cluster strips restarted with
 			// the current hit, otherwise it is lost!
 			hitsCount = 1;
-			maxAdc = -9999;
+			maxAdc = currentAdc;
+			maxIndex = hitsPlane.row(hit);
 			sumAdcs=currentAdc;
-			TempPlaneClusterHistogram->Reset();
-			TempPlaneClusterHistogram->Fill(currentStrip, currentAdc);	
+			ws.cluster_strips.assign(1, currentStrip);
+			ws.cluster_adcs.assign(1, currentAdc);
 			}
 			
 		lastStrip = currentStrip;
@@ -290,41 +554,30 @@ bool EventLoaderAPV25::MakePlaneClusters(std::vector<std::tuple<int16_t, int16_t
 
 	// Check again if there are clusters
 	if (hitsCount >= 2){
-		TempPlaneClusterHistogram->Fit("gaus", "q");
+		double position = PlaneClusterPosition(ws, which_plane);
 
-		// Cluster_Plane < strip, sumAdcs, cluster_size >
+		// Cluster_Plane < strip position, sumAdcs, cluster_size >
 		if (which_plane==0){ // X plane
-			Clusters_Plane_X.emplace_back(TempPlaneClusterHistogram->GetFunction("gaus")->GetParameter(1), sumAdcs, hitsCount);
-
-					for (int i=0; i<14; i++){
-            // negative values not filled
-            if (adcs->at(i)->At(maxIndex) > 0) {
-              LOG(DEBUG) << "adcs->at(maxIndex)->At(" << i <<") = " << adcs->at(i)->At(maxIndex);
-              maxHitWaveform_y->Fill(i, adcs->at(i)->At(maxIndex));
-              }
-            }				
+			ws.Clusters_Plane_X.emplace_back(position, sumAdcs, hitsCount);
+			ws.Cluster_Times_X.push_back(ClusterTime(ws, maxIndex));
+
+					FillMaxHitWaveform(ws, maxIndex, which_plane);
 		
 		}
 		else if (which_plane==1){ // Y plane
-			Clusters_Plane_Y.emplace_back(TempPlaneClusterHistogram->GetFunction("gaus")->GetParameter(1), sumAdcs, hitsCount);
+			ws.Clusters_Plane_Y.emplace_back(position, sumAdcs, hitsCount);
+			ws.Cluster_Times_Y.push_back(ClusterTime(ws, maxIndex));
 					
-					for (int i=0; i<14; i++){
-            // negative values not filled
-            if (adcs->at(i)->At(maxIndex) > 0) {
-              LOG(DEBUG) << "adcs->at(maxIndex)->At(" << i <<") = " << adcs->at(i)->At(maxIndex);
-              maxHitWaveform_y->Fill(i, adcs->at(i)->At(maxIndex));
-              }
-            }				
+					FillMaxHitWaveform(ws, maxIndex, which_plane);
 		
 		}
 
 		clusterCount++;
 	} 
 
-	delete TempPlaneClusterHistogram;
 	
-	// If there are more than 6 clusters in one plane, tracking is not done
-	if (clusterCount>=1 && clusterCount<=4) return true;
+	// If there are more than max_plane_clusters clusters in one plane, tracking is not done
+	if (clusterCount>=1 && clusterCount<=m_maxPlaneClusters) return true;
 	
 	// No clusters or more than 6 clusters on one plane
 	return false;
@@ -332,65 +585,223 @@ bool EventLoaderAPV25::MakePlaneClusters(std::vector<std::tuple<int16_t, int16_t
 
 
 
-int EventLoaderAPV25::MatchPlaneClusters(std::vector<std::tuple<int16_t, int16_t, int16_t>> &clustersX,
-                              						std::vector<std::tuple<int16_t, int16_t, int16_t>> &clustersY){
+void EventLoaderAPV25::LoadPedestals(const std::string& path){
 
+	auto pedestal_file = std::unique_ptr<TFile>(TFile::Open(path.c_str()));
+	if (!pedestal_file || pedestal_file->IsZombie()){
+		throw InvalidValueError(config_, "pedestal_file", "cannot open the file");
+	}
 
-	double ratio_sum = 0;
-	double bestRatio = std::numeric_limits<double>::max();
-	int index = 0;
-	int bestIndex = 0;
-	// Best match according to charge matching
-	
-			LOG(DEBUG) << "was here2";
-	// Clear matched cluster containers
-	curXYclusters.clear();
-	allClusters.clear();
+	config_.setDefault<std::string>("pedestal_tree", "pedestals");
+	auto tree_name = config_.get<std::string>("pedestal_tree");
+	if (!pedestal_file->Get(tree_name.c_str())){
+		throw InvalidValueError(config_, "pedestal_file", "no TTree " + tree_name + " in the file");
+	}
 
-	
-	// Need only half of the permutations, so we fix the x indices, and consider the permutations of 
-	// the y clusters.
+	// One entry per strip, only the strips of this detector are kept
+	TTreeReader pedestal_reader(tree_name.c_str(), pedestal_file.get());
+	TTreeReaderValue<int> ped_detID(pedestal_reader, "detID");
+	TTreeReaderValue<int> ped_planeID(pedestal_reader, "planeID");
+	TTreeReaderValue<int> ped_strip(pedestal_reader, "strip");
+	TTreeReaderValue<double> pedestal(pedestal_reader, "pedestal");
+	TTreeReaderValue<double> noise(pedestal_reader, "noise");
+
+	int strips = 0;
+	while (pedestal_reader.Next()){
+		if (*ped_detID == detectorID){
+			signal_correction.setPedestal(*ped_planeID, *ped_strip, *pedestal, *noise);
+			strips++;
+		}
+	}
+	LOG(INFO) << "Loaded pedestals of " << strips << " strips of " << m_detector->getName() << " from " << path;
+	if (strips == 0){
+		LOG(WARNING) << "No pedestals for detID " << detectorID << " in " << path;
+	}
+}
+
+
+
+std::string EventLoaderAPV25::CacheSettings() const {
+	// Everything the Pixels depend on; the geometry is not, it is applied to the Pixels later
+	std::string settings = "detID=" + std::to_string(detectorID);
+	for (const auto &key : {"number_of_timebins", "tot_threshold", "pedestal_file", "pedestal_tree", "common_mode",
+	                        "common_mode_trim_fraction", "common_mode_min_strips", "zero_suppression_sigma", "pixel_time",
+	                        "sampling_period", "shaping_time", "shaping_order", "event_length", "max_plane_clusters",
+	                        "position_estimator", "eta_correction"}){
+		settings += std::string(";") + key + "=" + (config_.has(key) ? config_.getText(key) : "");
+	}
+	return settings;
+}
 
-	do{
-			LOG(DEBUG) << "was here3";
-			for(size_t i=0; i< clustersX.size(); i++){
-				// XYclusters: < x_strip, y_strip, sum_charge, sum_clustSizes, Y_charge/X_charge >
-				
-				LOG(DEBUG) << "charge_ratio: " << static_cast<double>(std::get<1>(clustersY[i])) / std::get<1>(clustersX[i]);
-				
-				curXYclusters.emplace_back(
-						std::get<0>(clustersX[i]), 
-						std::get<0>(clustersY[i]), 
-						std::get<1>(clustersX[i])+std::get<1>(clustersY[i]), 
-						std::get<2>(clustersX[i])+std::get<2>(clustersY[i]), 
-						static_cast<double>(std::get<1>(clustersY[i])) / std::get<1>(clustersX[i])
-				);
-				ratio_sum += static_cast<double>(std::get<1>(clustersY[i])) / std::get<1>(clustersX[i]);
-				}
-			
-			LOG(DEBUG) << "ratio_sum: " << ratio_sum;
-			
-			if(ratio_sum<bestRatio && 0.5<ratio_sum/clustersX.size() && ratio_sum/clustersX.size()<1.5){
-					bestIndex = index;
-					bestRatio = ratio_sum;
-				}
-			
-			LOG(DEBUG) << "best_ratio " << bestRatio;
-			ratio_sum = 0;
-			index++;
-			allClusters.push_back(curXYclusters);
-			curXYclusters.clear();
-	}while(std::next_permutation(clustersY.begin(), clustersY.end()));
 
-			LOG(DEBUG) << "was here4";
 
-	// Return the best index
-	return bestIndex;
+double EventLoaderAPV25::ClusterTime(EventWorkspace &ws, size_t row){
+	// The cluster has the time of its highest strip
+	return m_pulseTiming ? ws.strip_times[row] : 0;
+}
+
+
 
+void EventLoaderAPV25::FillMaxHitWaveform(EventWorkspace &ws, size_t row, int which_plane){
+
+	auto samples = ws.hits->waveforms.row(row);
+	auto histogram = (which_plane==0) ? ws.maxHitWaveform_x : ws.maxHitWaveform_y;
+	for (int t=0; t<m_timebins; t++){
+		// negative values not filled
+		if (samples[t] > 0) {
+			HOT_PATH_TRACE(ws.hit_trace, "max hit waveform", "timebin", t, "adc", samples[t]);
+			histogram->Fill(t, samples[t]);
+		}
 	}
+}
+
+
+
+double EventLoaderAPV25::PlaneClusterPosition(EventWorkspace &ws, int which_plane){
+
+	// Reference mode: Gaussian fit of the strip charges
+	if (m_fitPosition){
+		TempPlaneClusterHistogram->Reset();
+		for (size_t i=0; i<ws.cluster_strips.size(); i++){
+			TempPlaneClusterHistogram->Fill(ws.cluster_strips[i], ws.cluster_adcs[i]);
+		}
+		TempPlaneClusterHistogram->Fit("gaus", "q");
+		double mean = TempPlaneClusterHistogram->GetFunction("gaus")->GetParameter(1);
+		HOT_PATH_TRACE(ws.hit_trace, "gaus fit", "plane", which_plane, "mean", mean);
+		return mean;
+	}
+
+	double eta = -1;
+	double position = cluster_position.estimate(ws.cluster_strips, ws.cluster_adcs, &eta);
+	if (eta >= 0){
+		(which_plane==0 ? ws.etaDistribution_x : ws.etaDistribution_y)->Fill(eta);
+	}
+	return position;
+}
+
+
+
+void EventLoaderAPV25::MatchPlaneClusters(EventWorkspace &ws){
+
+	const auto &clustersX = ws.Clusters_Plane_X;
+	const auto &clustersY = ws.Clusters_Plane_Y;
+
+	// Clear matched cluster container
+	ws.curXYclusters.clear();
+	ws.XY_Times.clear();
+
+	auto charge_ratio = [&](size_t i, size_t j) {
+		return static_cast<double>(std::get<1>(clustersY[j])) / std::get<1>(clustersX[i]);
+	};
+
+	// Best match according to charge matching: the pairing with the lowest sum of Y/X charge ratios,
+	// solved as an assignment problem instead of trying all permutations of the Y clusters. With
+	// different numbers of X and Y clusters the extra ones stay unpaired.
+	size_t nx = clustersX.size();
+	size_t ny = clustersY.size();
+	ws.match_cost.resize(nx * ny);
+	for (size_t i=0; i<nx; i++){
+		for (size_t j=0; j<ny; j++){
+			// An X cluster without charge gives an infinite ratio, which the solver cannot handle
+			auto ratio = charge_ratio(i, j);
+			ws.match_cost[i * ny + j] = std::isfinite(ratio) ? ratio : std::numeric_limits<float>::max();
+		}
+	}
+	auto pairing = minimumCostAssignment(ws.match_cost, nx, ny);
+
+	double ratio_sum = 0;
+	size_t pairs = 0;
+	for (size_t i=0; i<nx; i++){
+		if (pairing[i] >= 0){
+			ratio_sum += charge_ratio(i, static_cast<size_t>(pairing[i]));
+			pairs++;
+		}
+	}
+	HOT_PATH_TRACE(ws.hit_trace, "cluster matching", "ratio_sum", ratio_sum, "pairs", pairs);
+
+	// The mean charge ratio has to be between 0.5 and 1.5, otherwise the clusters are paired in strip order
+	double mean_ratio = ratio_sum / static_cast<double>(pairs);
+	if (!(0.5 < mean_ratio && mean_ratio < 1.5)){
+		for (size_t i=0; i<nx; i++){
+			pairing[i] = (i < ny) ? static_cast<int>(i) : -1;
+		}
+	}
+
+	for (size_t i=0; i<nx; i++){
+		if (pairing[i] < 0) continue;
+		auto j = static_cast<size_t>(pairing[i]);
+
+		// XYclusters: < x_strip, y_strip, sum_charge, sum_clustSizes, Y_charge/X_charge >
+		HOT_PATH_TRACE(ws.hit_trace, "cluster pair", "x", std::get<0>(clustersX[i]), "y", std::get<0>(clustersY[j]), "charge_ratio", charge_ratio(i, j));
+		ws.curXYclusters.emplace_back(
+				std::get<0>(clustersX[i]), 
+				std::get<0>(clustersY[j]), 
+				std::get<1>(clustersX[i])+std::get<1>(clustersY[j]), 
+				std::get<2>(clustersX[i])+std::get<2>(clustersY[j]), 
+				charge_ratio(i, j)
+		);
+		if (m_pulseTiming){
+			ws.XY_Times.push_back(0.5 * (ws.Cluster_Times_X[i] + ws.Cluster_Times_Y[j]));
+			ws.clusterTimeDifference->Fill(static_cast<double>(Units::convert(ws.Cluster_Times_X[i] - ws.Cluster_Times_Y[j], "ns")));
+		}
+	}
+}
 
 
 
 void EventLoaderAPV25::finalize(const std::shared_ptr<ReadonlyClipboard>&) {
   LOG(DEBUG) << "Analysed " << m_eventNumber << " events";
+
+  // Merge the histograms and counters of the workers into the ones of the module
+  long suppressed_strips = 0;
+  for (size_t w=0; w<workspaces.size(); w++){
+    auto &ws = workspaces[w];
+    suppressed_strips += ws.suppressed_strips;
+    hit_trace.merge(ws.hit_trace);
+    if (w == 0) continue;
+
+    auto merge = [](TH1F* histogram, TH1F* shard){
+      if (!shard) return;
+      histogram->Add(shard);
+      delete shard;
+    };
+    merge(maxHitWaveform_x, ws.maxHitWaveform_x);
+    merge(maxHitWaveform_y, ws.maxHitWaveform_y);
+    merge(peakTimebin, ws.peakTimebin);
+    merge(waveformIntegral, ws.waveformIntegral);
+    merge(timeOverThreshold, ws.timeOverThreshold);
+    merge(etaDistribution_x, ws.etaDistribution_x);
+    merge(etaDistribution_y, ws.etaDistribution_y);
+    merge(stripTime, ws.stripTime);
+    merge(clusterTimeDifference, ws.clusterTimeDifference);
+  }
+  worker_pool.reset();
+
+  // Only a cache of the whole input file can replace it in later runs
+  if (cluster_cache.writing()){
+    if (!m_inputComplete){
+      LOG(WARNING) << "The run stopped before the end of " << m_inputFile << ", the cluster cache of " << m_detector->getName() << " is not written";
+      cluster_cache.discard();
+    }
+    else if (cluster_cache.commit()){
+      LOG(INFO) << "Wrote the clusters of " << m_eventNumber << " events of " << m_detector->getName() << " to the cluster cache";
+    }
+    else {
+      LOG(WARNING) << "Writing the cluster cache of " << m_detector->getName() << " failed";
+    }
+  }
+
+  if (m_correctSignals){
+    LOG(INFO) << suppressed_strips << " strips of " << m_detector->getName() << " removed by the zero suppression";
+  }
+  if (hit_reader){
+    hit_reader->reportInputTime();
+  }
+  if (m_makeClusters){
+    cluster_factory.report(m_detector->getName(), m_eventNumber);
+  }
+  else {
+    pixel_factory.report(m_detector->getName(), m_eventNumber);
+  }
+  hit_trace.report(m_detector->getName());
 }
@@ -28,8 +28,24 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "APV25ClusterCache.h"
+#include "APV25ClusterPosition.h"
+#include "APV25HitDemultiplexer.h"
+#include "APV25PlaneHits.h"
+#include "APV25PulseTiming.h"
+#include "APV25SignalCorrection.h"
+#include "APV25WaveformMatrix.h"
+
 #include "core/module/Module.hpp"
+#include "objects/Cluster.hpp"
 #include "objects/Pixel.hpp"
+#include "tools/Assignment.h"
+#include "tools/AsyncInput.h"
+#include "tools/ChannelMap.h"
+#include "tools/DetectorGeometryCache.h"
+#include "tools/HotPathTrace.h"
+#include "tools/ObjectPool.h"
+#include "tools/WorkerPool.h"
 
 namespace corryvreckan {
   /** @ingroup Modules
@@ -73,57 +89,147 @@ namespace corryvreckan {
        * @brief Internal object storing objects and information to construct a message from tree
        */
 
-			bool MakePlaneClusters(std::vector<std::tuple<int16_t, int16_t, int8_t>> &hitsPlane, int which_plane);
-			int MatchPlaneClusters(std::vector<std::tuple<int16_t, int16_t, int16_t>> &clustersX, 
-															std::vector<std::tuple<int16_t, int16_t, int16_t>> &clustersY);
+			// Per-event state of the reconstruction, one per worker thread so events can be reconstructed in parallel
+			struct EventWorkspace {
+				// Hits_Plane < strip, maxAdc, waveform row >, sized for the strips of the plane in initialize
+				APV25PlaneHits Hits_Plane_X;
+				APV25PlaneHits Hits_Plane_Y;
+
+				// Cluster_Plane < strip position, sumAdcs, cluster_size >, the position in fractions of a strip
+				std::vector<std::tuple<double, int, int>> Clusters_Plane_X;
+				std::vector<std::tuple<double, int, int>> Clusters_Plane_Y;
+
+				// Time of the highest strip of each plane cluster
+				std::vector<double> Cluster_Times_X;
+				std::vector<double> Cluster_Times_Y;
+
+				// XYclusters: < x_strip, y_strip, sum_charge, sum_clustSizes, Y_charge/X_charge >
+				std::vector<std::tuple<double, double, int, int, double>> curXYclusters;
+				std::vector<double> XY_Times;
+
+				// Y/X charge ratio of every X and Y cluster pair, row-major in X
+				std::vector<double> match_cost;
+
+				// Strips and ADCs of the plane cluster being built
+				std::vector<int> cluster_strips;
+				std::vector<int> cluster_adcs;
+
+				// Hits of the event being reconstructed
+				APV25HitDemultiplexer::DetectorHits* hits{nullptr};
+
+				// Copies of the configured correction and timing, they keep scratch buffers
+				APV25SignalCorrection signal_correction;
+				std::vector<char> strip_kept;
+				long suppressed_strips{0};
+				APV25PulseTiming pulse_timing;
+				std::vector<size_t> timing_rows;
+				std::vector<int> timing_bins;
+				std::vector<double> timing_results;
+				std::vector<double> strip_times;
+
+				// The histograms of the first workspace are the ones of the module, the others are merged into them
+				TH1F * maxHitWaveform_x{nullptr};
+				TH1F * maxHitWaveform_y{nullptr};
+				TH1F * peakTimebin{nullptr};
+				TH1F * waveformIntegral{nullptr};
+				TH1F * timeOverThreshold{nullptr};
+				TH1F * etaDistribution_x{nullptr};
+				TH1F * etaDistribution_y{nullptr};
+				TH1F * stripTime{nullptr};
+				TH1F * clusterTimeDifference{nullptr};
+
+				HotPathTracer hit_trace;
+			};
+
+			// Matched XY cluster of an event, made into a Pixel or Cluster in the order of the events
+			struct PixelHit {
+				double column;
+				double row;
+				int charge;
+				double time;
+			};
+
+			void ReconstructEvent(EventWorkspace &ws, APV25HitDemultiplexer::DetectorHits &hits, int eventID, std::vector<PixelHit> &pixels);
+
+			// Puts the matched clusters of one event on the clipboard, as Pixels on the nearest strips or as Clusters
+			void StoreHits(const PixelHit* begin, const PixelHit* end, const std::shared_ptr<Clipboard>& clipboard);
+			bool MakePlaneClusters(EventWorkspace &ws, const APV25PlaneHits &hitsPlane, int which_plane);
+			void LoadPedestals(const std::string& path);
+			void FillMaxHitWaveform(EventWorkspace &ws, size_t row, int which_plane);
+			double ClusterTime(EventWorkspace &ws, size_t row);
+			double PlaneClusterPosition(EventWorkspace &ws, int which_plane);
+			void MatchPlaneClusters(EventWorkspace &ws);
 			
       std::shared_ptr<Detector> m_detector;
 
       std::string m_inputFile;
-      TFile * data_file;
-      TTree * data_tree;
+      std::string m_detectorName;
 			int detectorID;
-			std::string strip_axis="";
-
-      TTreeReader *reader;
-      TTreeReaderValue<int> *evtID;
-      TTreeReaderValue<int> *nch;
-			
-
-      TTreeReaderArray<int> *detID;
-      TTreeReaderArray<int> *strip;
-      TTreeReaderArray<int> *planeID;
-      TTreeReaderArray<int> *hitTimebin;
-
-			
-			std::vector<TTreeReaderArray<int16_t>*> *adcs; 
-
-			// Hits_Plane < strip, maxAdc, hitIndex>
-			std::vector<std::tuple<int16_t, int16_t, int8_t>> Hits_Plane_X;
-			std::vector<std::tuple<int16_t, int16_t, int8_t>> Hits_Plane_Y;
-    
 
-			// Cluster_Plane < strip, sumAdcs, cluster_size >
-			std::vector<std::tuple<int16_t, int16_t, int16_t>> Clusters_Plane_X;
-			std::vector<std::tuple<int16_t, int16_t, int16_t>> Clusters_Plane_Y;
+			// Reader of the THit TTree shared with the other detectors
+			std::shared_ptr<APV25HitDemultiplexer> hit_reader;
+			int m_timebins;
+			int16_t m_totThreshold;
+			TH1F * peakTimebin;
+			TH1F * waveformIntegral;
+			TH1F * timeOverThreshold;
+
+			// Pedestal and common mode correction of the matrix, strips failing the zero suppression are not clustered
+			bool m_correctSignals;
+			APV25SignalCorrection signal_correction;
+
+			// Pulse start time of the strips for the pixel_time = pulse_shape mode, all strips of an event in one batch
+			bool m_pulseTiming;
+			double m_eventLength;
+			APV25PulseTiming pulse_timing;
+			TH1F * stripTime{nullptr};
+			TH1F * clusterTimeDifference{nullptr};
+
+			int m_maxPlaneClusters;
+
+			// Position estimator of the plane clusters, the histogram is only used for the fit
+			bool m_fitPosition;
+			APV25ClusterPosition cluster_position;
+			TH1F * TempPlaneClusterHistogram{nullptr};
+			TH1F * etaDistribution_x{nullptr};
+			TH1F * etaDistribution_y{nullptr};
 
+			TH1F * maxHitWaveform_x;
+			TH1F * maxHitWaveform_y;
 
-      // XYclusters: < x_strip, y_strip, sum_charge, sum_clustSizes, Y_charge/X_charge >
-		  std::vector<std::tuple<int, int, int, int, double>> curXYclusters;
+			// Events are read in batches of event_batch_size, reconstructed by the worker threads if worker_threads is set
+			// and one at a time otherwise
+			size_t m_batchSize;
+			std::unique_ptr<WorkerPool> worker_pool;
+			std::vector<EventWorkspace> workspaces;
+			std::vector<std::vector<PixelHit>> batch_pixels;
+			size_t m_batchNext{0};
+
+			// Matched XY clusters read from or written to the cluster_cache, the THit reader is not used when reading
+			bool m_readCache{false};
+			bool m_inputComplete{false};
+			APV25ClusterCache cluster_cache;
+			std::vector<APV25ClusterCache::Record> cache_records;
+			std::string CacheSettings() const;
 
-			// Container for all matched xy clusters
-		  std::vector<std::vector<std::tuple<int, int, int, int, double>>> allClusters;
+			int m_eventNumber=0;
 
+			// Read-ahead settings, the time spent reading is measured and reported by the shared reader
+			AsyncInputSettings async_input;
 
+			// Creates the Pixels, from a pool if object_pool is set
+			ObjectFactory<Pixel> pixel_factory;
 
-			TH1F * TempPlaneClusterHistogram;
-			TH1F * curMaxHitWaveform;
-			TH1F * maxHitWaveform_x;
-			TH1F * maxHitWaveform_y;
-
+			// Clusters instead of Pixels, so the positions keep their fraction of a strip
+			bool m_makeClusters;
+			ObjectFactory<Cluster> cluster_factory;
+			DetectorGeometryCache geometry;
+			std::vector<PixelHit> cache_hits;
+			std::vector<double> local_x, local_y;
+			std::vector<double> global_x, global_y, global_z;
 
-			Long64_t number_of_entries=0;
-			int m_eventNumber=0;
+			// Per-hit tracing, only compiled with the CORRYVRECKAN_HOT_PATH_TRACE build option
+			HotPathTracer hit_trace;
   };
 
 } // namespace corryvreckan
@@ -17,134 +17,149 @@
 using namespace corryvreckan;
 
 EventLoaderVMM3a::EventLoaderVMM3a(Configuration& config, std::shared_ptr<Detector> detector)
-    : Module(config, detector), m_detector(detector) {
+    : Module(config, detector), m_detector(detector), async_input(config_) {
 			
 			
 			m_inputFile = config_.get<std::string>("file_input");
       LOG(DEBUG) << "Input file name: " << m_inputFile;
       LOG(DEBUG) << "Detector name: " << m_detector->getName();
+
+			config_.setDefault<bool>("object_pool", false);
+			pixel_factory = ObjectFactory<Pixel>(config_.get<bool>("object_pool"));
+			cluster_factory = ObjectFactory<Cluster>(config_.get<bool>("object_pool"));
+			m_detectorName = m_detector->getName();
+
+			config_.setDefault<int>("trace_sample_interval", 1000);
+			hit_trace = HotPathTracer(config_.get<int>("trace_sample_interval"));
+
+			config_.setDefault<bool>("cluster_strips", false);
+			config_.setDefault<double>("cluster_time_gap", Units::get<double>(200, "ns"));
+			config_.setDefault<int>("cluster_missing_strips", 0);
+			m_clusterStrips = config_.get<bool>("cluster_strips");
+			if (m_clusterStrips){
+				strip_clusterer = std::make_unique<VMM3aStripClusterer>(config_.get<double>("cluster_time_gap"), config_.get<int>("cluster_missing_strips"));
+			}
 			}
 
 void EventLoaderVMM3a::initialize() {
 		
 		LOG(DEBUG) << "Initialize EventLoaderVMM3a for " << m_detector->getName();
-		
-		data_file = TFile::Open(m_inputFile.c_str());
-		if (!data_file || data_file->IsZombie()){
-			LOG(DEBUG) << "Failed to open the data file: " << m_inputFile;
-			throw ModuleError("Error in opening TFile");
+
+		// Detector and plane ID of this strip plane in the hits TTree, from the channel_map or the GEMX<n>/GEMY<n> names
+		auto channel = ChannelMap(config_, 1).get(m_detector->getName());
+		if (channel.axis==ChannelMap::Axis::XY){
+			throw ModuleError("Detector " + m_detector->getName() + " is not a single strip plane, give its plane ID in the channel_map");
 		}
+		detectorID = channel.det_id;
+		planeID = channel.plane_id;
 
-		data_tree = dynamic_cast<TTree*>(data_file->Get("hits"));
-    if (!data_tree) {
-        LOG(ERROR) << "Failed to retrieve TTree 'hits' from file";
-        throw ModuleError("Failed to retrieve TTree 'hits'");
-    }
+		// All strip planes reading the same file share one reader, the file is walked only once
+		hit_reader = VMM3aHitDemultiplexer::getInstance(m_inputFile, async_input);
+		hit_reader->registerPlane(detectorID, planeID);
 
-		
-		number_of_entries = data_tree->GetEntries();
-		LOG(DEBUG) << "Number of entries in data_tree " << number_of_entries;
+		geometry = DetectorGeometryCache(m_detector);
 
-		reader = new TTreeReader("hits", data_file);
+		// The calibration is applied to the strip cluster positions, the Pixels only hold whole strips
+		if (m_clusterStrips){
+			strip_calibration = StripCalibration(config_, static_cast<int>(m_detector->nPixels().X()), static_cast<int>(m_detector->nPixels().Y()));
+		}
+		else {
+			StripCalibration::reject(config_, "strip calibration needs cluster_strips, Pixels only hold whole strips");
+		}
 
-		det = new TTreeReaderValue<unsigned char>(*reader, "det");
-		plane = new TTreeReaderValue<unsigned char>(*reader, "plane");
-		time = new TTreeReaderValue<double>(*reader, "time");
-		adc = new TTreeReaderValue<uint16_t>(*reader, "adc");
-		pos = new TTreeReaderValue<uint16_t>(*reader, "pos");
-		over_threshold = new TTreeReaderValue<bool>(*reader, "over_threshold");
-		
     // Initialise member variables
-    m_entry = 0;
+    m_eventNumber = 0;
 }
 
 StatusCode EventLoaderVMM3a::run(const std::shared_ptr<Clipboard>& clipboard) {
 		
-		reader->SetLocalEntry(m_entry);
-		
 		auto event = clipboard->getEvent();
 
-		// Make a container for pixels
-		PixelVector pixelContainer;
+		// The first strip plane of the event reads the whole event window for all planes
+		bool window_loaded = hit_reader->loadWindow(m_eventNumber, event->duration());
 
-		
+		// End the run if all entries read
+		if (!window_loaded){return StatusCode::EndRun;}
 
-		// Using the first hit as reference, reset the time at the start of every event
-		if (current_first==-1) current_first=**time;
+		// Group the hits of this plane into clusters while going through them, no Pixels are made
+		if (m_clusterStrips){
+			ClusterVector clusterContainer;
+			strip_clusterer->cluster(hit_reader->getHits(detectorID, planeID), strip_clusters);
 
-		while (true){
-			
-			// Current time is the reference to the first entry of the event defined by the metronome
-			current_time = **time-current_first;
+			// The calibration of the plane is applied to all cluster positions of the event at once
+			strip_positions.clear();
+			for (const auto& strip_cluster : strip_clusters){
+				strip_positions.push_back(strip_cluster.position);
+			}
+			if (strip_calibration.enabled()){
+				strip_calibration.apply(planeID, strip_positions, calibrated_positions, strips_alive);
+			}
+			else {
+				calibrated_positions = strip_positions;
+				strips_alive.assign(strip_positions.size(), 1);
+			}
 
-			LOG(DEBUG) << std::fixed << std::setprecision(10) << "(Entry " << m_entry << "):  current_time  =  " << current_time << ",  **time  =  " << **time;
-			
+			// Strip position is the column for the X plane and the row for the Y plane, like for the Pixels.
+			// All clusters of the event are transformed at once
+			local_x.clear();
+			local_y.clear();
+			for (auto position : calibrated_positions){
+				auto positionLocal = (planeID==0) ? geometry.getLocalPosition(position, 0) : geometry.getLocalPosition(0, position);
+				local_x.push_back(positionLocal.x());
+				local_y.push_back(positionLocal.y());
+			}
+			geometry.localToGlobal(local_x, local_y, global_x, global_y, global_z);
 
-			// Data has to be in the event timewindow, using event->duration()
-			// If current_time > event->duration(), breaking the event
-			
-			if (current_time > event->duration()){
-				LOG(DEBUG) << "============== Data outside event, breaking =============="; break;
+			for (size_t i=0; i<strip_clusters.size(); i++){
+				const auto& strip_cluster = strip_clusters[i];
+				if (!strips_alive[i]){
+					clusters_on_dead_strips++;
+					continue;
 				}
+				double column = (planeID==0) ? calibrated_positions[i] : 0;
+				double row = (planeID==0) ? 0 : calibrated_positions[i];
+
+				auto cluster = cluster_factory.make();
+				cluster->setColumn(column);
+				cluster->setRow(row);
+				cluster->setCharge(strip_cluster.charge);
+				cluster->setTimestamp(strip_cluster.time);
+				cluster->setDetectorID(m_detectorName);
+				cluster->setSplit(false);
+
+				cluster->setClusterCentreLocal(ROOT::Math::XYZPoint(local_x[i], local_y[i], 0));
+				cluster->setClusterCentre(ROOT::Math::XYZPoint(global_x[i], global_y[i], global_z[i]));
+				cluster->setError(geometry.getSpatialResolution(column, row));
+				cluster->setErrorMatrixGlobal(geometry.getSpatialResolutionMatrixGlobal(column, row));
+
+				HOT_PATH_TRACE(hit_trace, "cluster", "strip", strip_cluster.position, "size", strip_cluster.size, "charge", strip_cluster.charge, "time", strip_cluster.time);
+				clusterContainer.push_back(cluster);
+			}
 
+			m_eventNumber++;
+			clipboard->putData(clusterContainer, m_detectorName);
+			return StatusCode::Success;
+		}
 
-			// Change the detector names to match the corryvreckan geometry file! 
-			if(strcmp(m_detector->getName().c_str(), "GEMX1")==0 || strcmp(m_detector->getName().c_str(), "GEMY1")==0) detectorID=1;
-			if(strcmp(m_detector->getName().c_str(), "GEMX2")==0 || strcmp(m_detector->getName().c_str(), "GEMY2")==0) detectorID=2;
-			if(strcmp(m_detector->getName().c_str(), "GEMX3")==0 || strcmp(m_detector->getName().c_str(), "GEMY3")==0) detectorID=3;
-			if(strcmp(m_detector->getName().c_str(), "GEMX4")==0 || strcmp(m_detector->getName().c_str(), "GEMY4")==0) detectorID=4;
-
-			if(strcmp(m_detector->getName().c_str(), "GEMX1")==0) strip_axis="X";
-			if(strcmp(m_detector->getName().c_str(), "GEMY1")==0) strip_axis="Y";
-			if(strcmp(m_detector->getName().c_str(), "GEMX2")==0) strip_axis="X";
-			if(strcmp(m_detector->getName().c_str(), "GEMY2")==0) strip_axis="Y";
-			if(strcmp(m_detector->getName().c_str(), "GEMX3")==0) strip_axis="X";
-			if(strcmp(m_detector->getName().c_str(), "GEMY3")==0) strip_axis="Y";
-			if(strcmp(m_detector->getName().c_str(), "GEMX4")==0) strip_axis="X";
-			if(strcmp(m_detector->getName().c_str(), "GEMY4")==0) strip_axis="Y";
-
-
-			// Pixel args: 
-			// 	for x-plane: [detector_name, pos (col), 0 (row), raw (set to 1 if not known), adc, time]
-			// 	for y-plane: [detector_name, 0 (col), pos (row), raw (set to 1 if not known), adc, time]
-
-			// Has to be the correct plane and strip
-			if (static_cast<int>(**plane)==0 && detectorID==static_cast<int>(**det) && strip_axis=="X" && **over_threshold == 1){
-				auto pixel = std::make_shared<Pixel>(m_detector->getName(), **pos, 0, 1, **adc, **time);
-				pixelContainer.push_back(pixel);
-				LOG(DEBUG) << "HIT in Detector: " << m_detector->getName();
-				LOG(DEBUG) << "  det  :  plane  :  pos  :  adc  :  **time";
-				LOG(DEBUG) << std::fixed << std::setprecision(15) <<  "  " << static_cast<int>(**det) << "  " << static_cast<int>(**plane) << "  " << **pos << "  " << **adc << "  " << **time;
-			}
-			else {LOG(DEBUG) << "  No hits in x-plane";}
-			
-			if (static_cast<int>(**plane)==1 && detectorID==static_cast<int>(**det) && strip_axis=="Y" && **over_threshold == 1){
-				auto pixel = std::make_shared<Pixel>(m_detector->getName(), 0, **pos, 1, **adc, **time);
-				pixelContainer.push_back(pixel);
-				LOG(DEBUG) << "HIT in Detector: " << m_detector->getName();
-				LOG(DEBUG) << "  det  :  plane  :  pos  :  adc  :  **time";
-				LOG(DEBUG) << std::fixed << std::setprecision(15) <<  "  " << static_cast<int>(**det) << "  " << static_cast<int>(**plane) << "  " << **pos << "  " << **adc << "  " << **time;
-			}
-			else {LOG(DEBUG) << "  No hits in y-plane";}
-			
-			// Next entry
-			m_entry++;
+		// Make a container for pixels
+		PixelVector pixelContainer;
 
-			// Check again if there are any entries left, if not, end the run
-			if (m_entry > number_of_entries){
-				LOG(DEBUG) << "Run ended, all entries read";
-				break;
-				}
-			else {reader->SetLocalEntry(m_entry);}
-		
-		} // while(true)
-		
+		// Pixel args: 
+		// 	for x-plane: [detector_name, pos (col), 0 (row), raw (set to 1 if not known), adc, time]
+		// 	for y-plane: [detector_name, 0 (col), pos (row), raw (set to 1 if not known), adc, time]
 
-		// End the run if all entries read
-		if (m_entry > number_of_entries){return StatusCode::EndRun;}
+		// Only over threshold hits of this plane are in the bucket
+		for (const auto& hit : hit_reader->getHits(detectorID, planeID)){
+			if (planeID==0){
+				pixelContainer.push_back(pixel_factory.make(m_detectorName, hit.pos, 0, 1, hit.adc, hit.time));
+			}
+			else {
+				pixelContainer.push_back(pixel_factory.make(m_detectorName, 0, hit.pos, 1, hit.adc, hit.time));
+			}
+			HOT_PATH_TRACE(hit_trace, "hit", "det", detectorID, "plane", planeID, "pos", hit.pos, "adc", hit.adc, "time", hit.time);
+		}
 
-		// Reset the current event reference
-		current_first = -1;
+		m_eventNumber++;
 
 		// Add data to clipboard, for each detector
    	clipboard->putData(pixelContainer, m_detector->getName());
@@ -156,5 +171,17 @@ StatusCode EventLoaderVMM3a::run(const std::shared_ptr<Clipboard>& clipboard) {
 
 void EventLoaderVMM3a::finalize(const std::shared_ptr<ReadonlyClipboard>&) { 
 	
-	// Event = many entries, m_entry = hit, in our case
-	LOG(DEBUG) << "Analysed " << m_entry << " hits"; }
+	// Event = many entries, entry = hit, in our case
+	LOG(DEBUG) << "Analysed " << m_eventNumber << " events, " << hit_reader->getEntriesRead() << " hits read from " << m_inputFile;
+	hit_reader->reportInputTime();
+	hit_trace.report(m_detector->getName());
+	if (m_clusterStrips){
+		cluster_factory.report(m_detector->getName(), m_eventNumber);
+		if (strip_calibration.enabled()){
+			LOG(INFO) << m_detector->getName() << ": " << clusters_on_dead_strips << " clusters on dead strips dropped";
+		}
+	}
+	else {
+		pixel_factory.report(m_detector->getName(), m_eventNumber);
+	}
+	}
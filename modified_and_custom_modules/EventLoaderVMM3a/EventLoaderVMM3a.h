@@ -25,6 +25,14 @@
 #include "objects/Pixel.hpp"
 #include "objects/Track.hpp"
 
+#include "VMM3aHitDemultiplexer.h"
+#include "VMM3aStripClusterer.h"
+#include "tools/ChannelMap.h"
+#include "tools/DetectorGeometryCache.h"
+#include "tools/HotPathTrace.h"
+#include "tools/ObjectPool.h"
+#include "tools/StripCalibration.h"
+
 
 namespace corryvreckan {
     /** @ingroup Modules
@@ -60,25 +68,41 @@ namespace corryvreckan {
     private:
 				std::shared_ptr<Detector> m_detector;
 
-        Long64_t m_entry;
-				Long64_t number_of_entries;
+				long m_eventNumber;
 				std::string m_inputFile;
+				// Copied into every Pixel, taken once instead of calling getName() per hit
+				std::string m_detectorName;
 				int detectorID;
-				std::string strip_axis="";
-				double current_first = -1;
-				double current_time = -1;
-
-
-				TFile* data_file;
-				TTree* data_tree;
-				
-				TTreeReader *reader;
-				TTreeReaderValue<double> * time;
-				TTreeReaderValue<unsigned char> *det;		
-				TTreeReaderValue<unsigned char> *plane;		
-				TTreeReaderValue<bool> *over_threshold;		
-				TTreeReaderValue<uint16_t> *adc;
-    		TTreeReaderValue<uint16_t> *pos;
+				int planeID;
+
+				// Reader of the hits TTree shared with the other strip planes
+				std::shared_ptr<VMM3aHitDemultiplexer> hit_reader;
+
+				// Read-ahead settings, the time spent reading is measured and reported by the shared reader
+				AsyncInputSettings async_input;
+
+				// Creates the Pixels, from a pool if object_pool is set
+				ObjectFactory<Pixel> pixel_factory;
+
+				// Clustering of the strip hits while they are read, instead of putting Pixels on the clipboard
+				bool m_clusterStrips;
+				std::unique_ptr<VMM3aStripClusterer> strip_clusterer;
+				std::vector<VMM3aStripClusterer::StripCluster> strip_clusters;
+				ObjectFactory<Cluster> cluster_factory;
+
+				// Transformations and resolution of the strip plane, and the positions of the clusters of an event
+				DetectorGeometryCache geometry;
+				std::vector<double> local_x, local_y;
+				std::vector<double> global_x, global_y, global_z;
+
+				// Calibration of the cluster strip positions of this plane
+				StripCalibration strip_calibration;
+				std::vector<double> strip_positions, calibrated_positions;
+				std::vector<unsigned char> strips_alive;
+				long clusters_on_dead_strips{0};
+
+				// Per-hit tracing, only compiled with the CORRYVRECKAN_HOT_PATH_TRACE build option
+				HotPathTracer hit_trace;
     
     };
 
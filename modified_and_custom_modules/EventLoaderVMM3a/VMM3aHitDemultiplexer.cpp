@@ -0,0 +1,163 @@
+/**
+ * @file
+ * @brief Implementation of the shared hits TTree reader of EventLoaderVMM3a
+ *
+ * @copyright Copyright (c) 2020 CERN and the Corryvreckan authors.
+ * This software is distributed under the terms of the MIT License, copied verbatim in the file "LICENSE.md".
+ * In applying this license, CERN does not waive the privileges and immunities granted to it by virtue of its status as an
+ * Intergovernmental Organization or submit itself to any jurisdiction.
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "VMM3aHitDemultiplexer.h"
+
+#include "core/module/exceptions.h"
+#include "core/utils/log.h"
+
+using namespace corryvreckan;
+
+std::map<std::string, std::weak_ptr<VMM3aHitDemultiplexer>> VMM3aHitDemultiplexer::instances_;
+std::mutex VMM3aHitDemultiplexer::instances_mutex_;
+
+std::shared_ptr<VMM3aHitDemultiplexer> VMM3aHitDemultiplexer::getInstance(const std::string& file_name,
+                                                                          const AsyncInputSettings& async_input) {
+    std::lock_guard<std::mutex> lock(instances_mutex_);
+
+    auto instance = instances_[file_name].lock();
+    if(!instance) {
+        instance = std::shared_ptr<VMM3aHitDemultiplexer>(new VMM3aHitDemultiplexer(file_name, async_input));
+        instances_[file_name] = instance;
+    }
+    return instance;
+}
+
+VMM3aHitDemultiplexer::VMM3aHitDemultiplexer(const std::string& file_name, const AsyncInputSettings& async_input)
+    : m_inputFile(file_name), m_bucketIndex(256 * 256, -1) {
+
+    prepareAsyncInput(async_input);
+    data_file = TFile::Open(m_inputFile.c_str());
+    if(!data_file || data_file->IsZombie()) {
+        LOG(DEBUG) << "Failed to open the data file: " << m_inputFile;
+        throw ModuleError("Error in opening TFile");
+    }
+
+    data_tree = dynamic_cast<TTree*>(data_file->Get("hits"));
+    if(!data_tree) {
+        LOG(ERROR) << "Failed to retrieve TTree 'hits' from file";
+        throw ModuleError("Failed to retrieve TTree 'hits'");
+    }
+
+    configureAsyncInput(data_tree, async_input);
+
+    number_of_entries = data_tree->GetEntries();
+    LOG(DEBUG) << "Number of entries in data_tree " << number_of_entries;
+
+    // Reads the time column once, so the event windows can be found with a binary search
+    time_index = TimeIndex(data_tree, "time");
+    if(!time_index.isSorted()) {
+        LOG(WARNING) << "Hits in " << m_inputFile << " are not sorted in time, event windows are searched linearly";
+    }
+
+    det_reader = BulkBranchReader<unsigned char>(data_tree, "det");
+    plane_reader = BulkBranchReader<unsigned char>(data_tree, "plane");
+    over_threshold_reader = BulkBranchReader<unsigned char>(data_tree, "over_threshold");
+    adc_reader = BulkBranchReader<uint16_t>(data_tree, "adc");
+    pos_reader = BulkBranchReader<uint16_t>(data_tree, "pos");
+}
+
+VMM3aHitDemultiplexer::~VMM3aHitDemultiplexer() { delete data_file; }
+
+void VMM3aHitDemultiplexer::registerPlane(int det_id, int plane_id) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto& index = m_bucketIndex.at(bucketKey(det_id, plane_id));
+    if(index < 0) {
+        index = static_cast<int>(m_buckets.size());
+        m_buckets.emplace_back();
+    }
+}
+
+bool VMM3aHitDemultiplexer::loadWindow(long window, double duration) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Another detector instance already read this event window
+    if(window == m_window) {
+        return !m_endOfRun;
+    }
+    if(window != m_window + 1) {
+        throw ModuleError("Event window " + std::to_string(window) + " requested from " + m_inputFile +
+                          " after window " + std::to_string(m_window));
+    }
+    m_window = window;
+
+    for(auto& bucket : m_buckets) {
+        bucket.clear();
+    }
+
+    if(m_endOfRun || m_entry >= number_of_entries) {
+        m_endOfRun = true;
+        return false;
+    }
+
+    // The first hit is the reference of the event time window, all hits up to the first one
+    // outside the window belong to this event
+    auto stall = std::make_unique<InputStallTimer::Scope>(input_time);
+    auto last = time_index.findWindowEnd(m_entry, time_index.getTime(m_entry), duration);
+    if(last >= number_of_entries) {
+        LOG(DEBUG) << "Run ended, all entries read";
+        m_entry = number_of_entries;
+        m_endOfRun = true;
+        return false;
+    }
+
+    readRange(last);
+    stall.reset();
+    for(size_t i = 0; i < time.size(); i++) {
+        if(over_threshold[i]) {
+            auto index = m_bucketIndex[bucketKey(det[i], plane[i])];
+            if(index >= 0) {
+                m_buckets[static_cast<size_t>(index)].push_back({time[i], adc[i], pos[i]});
+            }
+        }
+    }
+    m_entry = last;
+
+    return true;
+}
+
+void VMM3aHitDemultiplexer::reportInputTime() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if(!m_inputReported) {
+        m_inputReported = true;
+        input_time.report(m_inputFile, m_window + 1);
+    }
+}
+
+void VMM3aHitDemultiplexer::readRange(Long64_t last) {
+    time.clear();
+    det.clear();
+    plane.clear();
+    over_threshold.clear();
+    adc.clear();
+    pos.clear();
+
+    // The bulk reads bypass TTree::GetEntry, tell the tree where we are so the read-ahead cache follows
+    data_tree->LoadTree(m_entry);
+
+    time_index.read(m_entry, last, time);
+    det_reader.read(m_entry, last, det);
+    plane_reader.read(m_entry, last, plane);
+    over_threshold_reader.read(m_entry, last, over_threshold);
+    adc_reader.read(m_entry, last, adc);
+    pos_reader.read(m_entry, last, pos);
+
+    LOG(TRACE) << "Read entries " << m_entry << " to " << last << " of " << m_inputFile;
+}
+
+const std::vector<VMM3aHitDemultiplexer::Hit>& VMM3aHitDemultiplexer::getHits(int det_id, int plane_id) const {
+    static const std::vector<Hit> no_hits;
+
+    auto index = m_bucketIndex.at(bucketKey(det_id, plane_id));
+    return index < 0 ? no_hits : m_buckets[static_cast<size_t>(index)];
+}
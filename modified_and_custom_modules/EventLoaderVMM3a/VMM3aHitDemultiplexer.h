@@ -0,0 +1,140 @@
+/**
+ * @file
+ * @brief Definition of the shared hits TTree reader of EventLoaderVMM3a
+ *
+ * @copyright Copyright (c) 2020 CERN and the Corryvreckan authors.
+ * This software is distributed under the terms of the MIT License, copied verbatim in the file "LICENSE.md".
+ * In applying this license, CERN does not waive the privileges and immunities granted to it by virtue of its status as an
+ * Intergovernmental Organization or submit itself to any jurisdiction.
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef VMM3aHitDemultiplexer_H
+#define VMM3aHitDemultiplexer_H 1
+
+#include <TFile.h>
+#include <TTree.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "tools/AsyncInput.h"
+#include "tools/BulkBranchReader.h"
+#include "tools/TimeIndex.h"
+
+namespace corryvreckan {
+    /**
+     * @brief Reader of the vmm-sdat hits TTree shared by all EventLoaderVMM3a instances
+     *
+     * Every strip plane registers its (det, plane) pair once. The tree is then walked a single time per event window
+     * and the over-threshold hits are put in the bucket of their plane, from where each detector instance picks up its
+     * own hits. This way the file is read and decompressed once per run instead of once per strip plane.
+     *
+     * The end of each event window is found with a binary search in a time index built when the file is opened. The
+     * entries of the window are then read as one range into contiguous columns, and the threshold selection runs over
+     * these arrays instead of going through a TTreeReader entry by entry.
+     */
+    class VMM3aHitDemultiplexer {
+
+    public:
+        // Over-threshold strip hit handed to the detector instances
+        struct Hit {
+            double time;
+            uint16_t adc;
+            uint16_t pos;
+        };
+
+        /**
+         * @brief Get the reader of an input file, the file is opened by the first caller
+         * @param file_name ROOT file containing the hits TTree
+         * @param async_input Read-ahead settings, only used by the caller that opens the file
+         */
+        static std::shared_ptr<VMM3aHitDemultiplexer> getInstance(const std::string& file_name,
+                                                                   const AsyncInputSettings& async_input);
+
+        ~VMM3aHitDemultiplexer();
+
+        /**
+         * @brief Request the hits of a strip plane to be kept
+         * @param det_id Detector ID in the hits TTree
+         * @param plane_id Plane ID in the hits TTree, 0 for X and 1 for Y strips
+         */
+        void registerPlane(int det_id, int plane_id);
+
+        /**
+         * @brief Read the hits of an event window, unless another instance already read it
+         * @param window Sequential number of the event window
+         * @param duration Length of the event window, counted from the first hit of the window
+         * @return False if all entries were read before the window was complete
+         */
+        bool loadWindow(long window, double duration);
+
+        /**
+         * @brief Hits of the current event window for one registered strip plane
+         */
+        const std::vector<Hit>& getHits(int det_id, int plane_id) const;
+
+        Long64_t getEntriesRead() const { return m_entry; }
+
+        /**
+         * @brief Log the time spent in the ROOT reads of the file, only the first instance calling it reports
+         */
+        void reportInputTime();
+
+    private:
+        VMM3aHitDemultiplexer(const std::string& file_name, const AsyncInputSettings& async_input);
+
+        // det and plane are stored as unsigned char, so a flat table covers all combinations
+        static size_t bucketKey(int det_id, int plane_id) {
+            return static_cast<size_t>(det_id) * 256 + static_cast<size_t>(plane_id);
+        }
+
+        // Read the entries [m_entry, last) into the columns
+        void readRange(Long64_t last);
+
+        std::string m_inputFile;
+        TFile* data_file;
+        TTree* data_tree;
+        Long64_t number_of_entries;
+        Long64_t m_entry{0};
+
+        // Index of the time branch, also reads the time column
+        TimeIndex time_index;
+
+        // Column readers of the other used branches, over_threshold is a one byte bool
+        BulkBranchReader<unsigned char> det_reader;
+        BulkBranchReader<unsigned char> plane_reader;
+        BulkBranchReader<unsigned char> over_threshold_reader;
+        BulkBranchReader<uint16_t> adc_reader;
+        BulkBranchReader<uint16_t> pos_reader;
+
+        // Structure of arrays holding the entries of the current event window
+        std::vector<double> time;
+        std::vector<unsigned char> det;
+        std::vector<unsigned char> plane;
+        std::vector<unsigned char> over_threshold;
+        std::vector<uint16_t> adc;
+        std::vector<uint16_t> pos;
+
+        long m_window{-1};
+        bool m_endOfRun{false};
+
+        // Time spent in the time index lookups and range reads, without the bucketing of the hits
+        InputStallTimer input_time;
+        bool m_inputReported{false};
+
+        // Index of the bucket for each (det, plane), -1 for planes nobody asked for
+        std::vector<int> m_bucketIndex;
+        std::vector<std::vector<Hit>> m_buckets;
+
+        std::mutex m_mutex;
+
+        static std::map<std::string, std::weak_ptr<VMM3aHitDemultiplexer>> instances_;
+        static std::mutex instances_mutex_;
+    };
+
+} // namespace corryvreckan
+#endif // VMM3aHitDemultiplexer_H
@@ -0,0 +1,96 @@
+/**
+ * @file
+ * @brief Implementation of the streaming strip clusterer of EventLoaderVMM3a
+ *
+ * @copyright Copyright (c) 2020 CERN and the Corryvreckan authors.
+ * This software is distributed under the terms of the MIT License, copied verbatim in the file "LICENSE.md".
+ * In applying this license, CERN does not waive the privileges and immunities granted to it by virtue of its status as an
+ * Intergovernmental Organization or submit itself to any jurisdiction.
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "VMM3aStripClusterer.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace corryvreckan;
+
+VMM3aStripClusterer::VMM3aStripClusterer(double time_gap, int missing_strips)
+    : m_timeGap(time_gap), m_stripGap(missing_strips + 1) {}
+
+void VMM3aStripClusterer::cluster(const std::vector<VMM3aHitDemultiplexer::Hit>& hits,
+                                  std::vector<StripCluster>& clusters) {
+    clusters.clear();
+    m_open.clear();
+
+    for(const auto& hit : hits) {
+        int strip = hit.pos;
+
+        // Clusters the stream has moved past cannot get any more hits
+        for(size_t i = m_open.size(); i-- > 0;) {
+            if(hit.time - m_open[i].last_time > m_timeGap) {
+                close(i, clusters);
+            }
+        }
+
+        // Add the hit to the first matching cluster, and merge any other cluster it connects to
+        OpenCluster* target = nullptr;
+        for(size_t i = 0; i < m_open.size();) {
+            auto& open = m_open[i];
+            bool matches = strip >= open.first_strip - m_stripGap && strip <= open.last_strip + m_stripGap &&
+                           std::abs(hit.time - open.last_time) <= m_timeGap;
+            if(!matches) {
+                i++;
+                continue;
+            }
+
+            if(target == nullptr) {
+                target = &open;
+                i++;
+                continue;
+            }
+
+            target->first_strip = std::min(target->first_strip, open.first_strip);
+            target->last_strip = std::max(target->last_strip, open.last_strip);
+            target->first_time = std::min(target->first_time, open.first_time);
+            target->last_time = std::max(target->last_time, open.last_time);
+            target->charge += open.charge;
+            target->weighted_strips += open.weighted_strips;
+            target->size += open.size;
+
+            // target points before i, so removing i by swapping with the back keeps it valid
+            open = m_open.back();
+            m_open.pop_back();
+        }
+
+        if(target == nullptr) {
+            m_open.push_back({strip, strip, hit.time, hit.time, 0., 0., 0});
+            target = &m_open.back();
+        }
+
+        target->first_strip = std::min(target->first_strip, strip);
+        target->last_strip = std::max(target->last_strip, strip);
+        target->first_time = std::min(target->first_time, hit.time);
+        target->last_time = std::max(target->last_time, hit.time);
+        target->charge += hit.adc;
+        target->weighted_strips += static_cast<double>(hit.adc) * strip;
+        target->size++;
+    }
+
+    // The event window ends all clusters still open
+    while(!m_open.empty()) {
+        close(m_open.size() - 1, clusters);
+    }
+}
+
+void VMM3aStripClusterer::close(size_t index, std::vector<StripCluster>& clusters) {
+    const auto& open = m_open[index];
+
+    // Hits with zero charge still give a position, the plain mean of the strip range
+    auto position = (open.charge > 0 ? open.weighted_strips / open.charge : 0.5 * (open.first_strip + open.last_strip));
+    clusters.push_back({position, open.charge, open.first_time, open.size});
+
+    m_open[index] = m_open.back();
+    m_open.pop_back();
+}
@@ -0,0 +1,76 @@
+/**
+ * @file
+ * @brief Definition of the streaming strip clusterer of EventLoaderVMM3a
+ *
+ * @copyright Copyright (c) 2020 CERN and the Corryvreckan authors.
+ * This software is distributed under the terms of the MIT License, copied verbatim in the file "LICENSE.md".
+ * In applying this license, CERN does not waive the privileges and immunities granted to it by virtue of its status as an
+ * Intergovernmental Organization or submit itself to any jurisdiction.
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef VMM3aStripClusterer_H
+#define VMM3aStripClusterer_H 1
+
+#include <cstdint>
+#include <vector>
+
+#include "VMM3aHitDemultiplexer.h"
+
+namespace corryvreckan {
+    /**
+     * @brief Groups the time ordered hits of one strip plane into clusters in a single pass
+     *
+     * A hit joins an open cluster if its strip is next to the strips of the cluster, allowing for a number of missing
+     * strips, and if it is within the time gap of the latest hit of the cluster. A cluster is closed as soon as the
+     * stream has moved more than the time gap past its latest hit, so only the few clusters active at the current time
+     * are kept open and the hits never have to be sorted by strip.
+     */
+    class VMM3aStripClusterer {
+
+    public:
+        // Finished cluster of one strip plane
+        struct StripCluster {
+            // Charge weighted mean strip
+            double position;
+            double charge;
+            // Time of the earliest hit
+            double time;
+            int size;
+        };
+
+        /**
+         * @brief Constructor
+         * @param time_gap Largest time between a hit and the latest hit of the cluster it joins
+         * @param missing_strips Number of strips without hit allowed between two strips of a cluster
+         */
+        VMM3aStripClusterer(double time_gap, int missing_strips);
+
+        /**
+         * @brief Cluster the hits of one event window
+         * @param hits Hits of a strip plane, ordered in time
+         * @param clusters Output clusters, the container is cleared first
+         */
+        void cluster(const std::vector<VMM3aHitDemultiplexer::Hit>& hits, std::vector<StripCluster>& clusters);
+
+    private:
+        struct OpenCluster {
+            int first_strip;
+            int last_strip;
+            double first_time;
+            double last_time;
+            double charge;
+            double weighted_strips;
+            int size;
+        };
+
+        void close(size_t index, std::vector<StripCluster>& clusters);
+
+        double m_timeGap;
+        int m_stripGap;
+
+        std::vector<OpenCluster> m_open;
+    };
+
+} // namespace corryvreckan
+#endif // VMM3aStripClusterer_H
@@ -10,6 +10,7 @@
  */
 
 #include "TreeWriter.h"
+#include <algorithm>
 #include <vector>
 
 using namespace corryvreckan;
@@ -47,28 +48,36 @@ void TreeWriter::initialize() {
   // Create the output branches
   m_outputTree->Branch("eventID", &eventID, "eventID/I");
 
+	// All XY GEMs found in the channel_map or by their GEMXY<n> names get their own set of branches
+	auto channel_map = ChannelMap(config_, 1);
+	for(auto& detector : get_detectors()) {
+		auto channel = channel_map.find(detector->getName());
+		if(channel && channel->axis == ChannelMap::Axis::XY) {
+			m_gems.push_back({detector, channel->det_id, 0, 0, 0, 0, 0});
+		}
+	}
+	std::sort(m_gems.begin(), m_gems.end(),
+						[](const GemBranches& a, const GemBranches& b) { return a.det_id < b.det_id; });
+	LOG(DEBUG) << "Writing branches for " << m_gems.size() << " GEMs";
+
 	// Branches for cluster data
-	
-	m_outputTree->Branch("cluster_XYcharge_gem1", &xyCharge_gem1);
-	m_outputTree->Branch("cluster_XYcharge_gem2", &xyCharge_gem2);
-	m_outputTree->Branch("cluster_XYcharge_gem3", &xyCharge_gem3);
-
-	m_outputTree->Branch("clustPos_x_gem1", &clustPos_x_gem1);
-	m_outputTree->Branch("clustPos_x_gem2", &clustPos_x_gem2);
-	m_outputTree->Branch("clustPos_x_gem3", &clustPos_x_gem3);
-	
-	m_outputTree->Branch("clustPos_y_gem1", &clustPos_y_gem1);
-	m_outputTree->Branch("clustPos_y_gem2", &clustPos_y_gem2);
-	m_outputTree->Branch("clustPos_y_gem3", &clustPos_y_gem3);
+	for(auto& gem : m_gems) {
+		m_outputTree->Branch(("cluster_XYcharge_gem" + std::to_string(gem.det_id)).c_str(), &gem.xyCharge);
+	}
+	for(auto& gem : m_gems) {
+		m_outputTree->Branch(("clustPos_x_gem" + std::to_string(gem.det_id)).c_str(), &gem.clustPos_x);
+	}
+	for(auto& gem : m_gems) {
+		m_outputTree->Branch(("clustPos_y_gem" + std::to_string(gem.det_id)).c_str(), &gem.clustPos_y);
+	}
 
 	// Branches for track data
-	m_outputTree->Branch("trackIntercept_x_gem1", &trackIntercept_x_gem1);
-	m_outputTree->Branch("trackIntercept_x_gem2", &trackIntercept_x_gem2);
-	m_outputTree->Branch("trackIntercept_x_gem3", &trackIntercept_x_gem3);
-
-	m_outputTree->Branch("trackIntercept_y_gem1", &trackIntercept_y_gem1);
-	m_outputTree->Branch("trackIntercept_y_gem2", &trackIntercept_y_gem2);
-	m_outputTree->Branch("trackIntercept_y_gem3", &trackIntercept_y_gem3);
+	for(auto& gem : m_gems) {
+		m_outputTree->Branch(("trackIntercept_x_gem" + std::to_string(gem.det_id)).c_str(), &gem.trackIntercept_x);
+	}
+	for(auto& gem : m_gems) {
+		m_outputTree->Branch(("trackIntercept_y_gem" + std::to_string(gem.det_id)).c_str(), &gem.trackIntercept_y);
+	}
 
 	m_outputTree->Branch("intercept_at_800mm", &intercept_at_800mm);
 
@@ -91,25 +100,13 @@ StatusCode TreeWriter::run(const std::shared_ptr<Clipboard>& clipboard) {
 		// If no tracks, pushing back empty entries.
 		
 
-		xyCharge_gem1 = std::numeric_limits<double>::quiet_NaN();
-		xyCharge_gem2 = std::numeric_limits<double>::quiet_NaN();
-		xyCharge_gem3 = std::numeric_limits<double>::quiet_NaN();
-
-		clustPos_x_gem1 = std::numeric_limits<double>::quiet_NaN();
-		clustPos_x_gem2 = std::numeric_limits<double>::quiet_NaN();
-		clustPos_x_gem3 = std::numeric_limits<double>::quiet_NaN();
-
-		clustPos_y_gem1 = std::numeric_limits<double>::quiet_NaN();
-		clustPos_y_gem2 = std::numeric_limits<double>::quiet_NaN();
-		clustPos_y_gem3 = std::numeric_limits<double>::quiet_NaN();
-
-		trackIntercept_x_gem1 = std::numeric_limits<double>::quiet_NaN();
-		trackIntercept_x_gem2 = std::numeric_limits<double>::quiet_NaN();
-		trackIntercept_x_gem3 = std::numeric_limits<double>::quiet_NaN();
-
-		trackIntercept_y_gem1 = std::numeric_limits<double>::quiet_NaN();
-		trackIntercept_y_gem2 = std::numeric_limits<double>::quiet_NaN();
-		trackIntercept_y_gem3 = std::numeric_limits<double>::quiet_NaN();
+		for(auto& gem : m_gems) {
+			gem.xyCharge = std::numeric_limits<double>::quiet_NaN();
+			gem.clustPos_x = std::numeric_limits<double>::quiet_NaN();
+			gem.clustPos_y = std::numeric_limits<double>::quiet_NaN();
+			gem.trackIntercept_x = std::numeric_limits<double>::quiet_NaN();
+			gem.trackIntercept_y = std::numeric_limits<double>::quiet_NaN();
+		}
 
 		// Creating empty ROOT objects
 		ROOT::Math::XYZPoint P;
@@ -123,7 +120,8 @@ StatusCode TreeWriter::run(const std::shared_ptr<Clipboard>& clipboard) {
 		return StatusCode::NoData;
 		}
 
-  for(auto& detector : get_detectors()) {
+  for(auto& gem : m_gems) {
+		auto& detector = gem.detector;
 
 		// Getting cluster data, stored with a detector name key
 		auto clusters = clipboard->getData<Cluster>(detector->getName());
@@ -133,27 +131,10 @@ StatusCode TreeWriter::run(const std::shared_ptr<Clipboard>& clipboard) {
 					LOG(DEBUG) << "cluster timestamp: " << cluster->timestamp();
 					
 					// add clust pos charge, when charge in cluster
-				
-				
-				if(strcmp(detector->getName().c_str(), "GEMXY1")==0){
-					clustPos_x_gem1 = cluster->local().x();
-					clustPos_y_gem1 = cluster->local().y();
-					xyCharge_gem1 = cluster->charge();
-					eventID=int(cluster->timestamp());
-				}
-				if(strcmp(detector->getName().c_str(), "GEMXY2")==0){
-					clustPos_x_gem2 = cluster->local().x();
-					clustPos_y_gem2 = cluster->local().y();
-					xyCharge_gem2 = cluster->charge();
+					gem.clustPos_x = cluster->local().x();
+					gem.clustPos_y = cluster->local().y();
+					gem.xyCharge = cluster->charge();
 					eventID=int(cluster->timestamp());
-				}
-				if(strcmp(detector->getName().c_str(), "GEMXY3")==0){
-					clustPos_x_gem3 = cluster->local().x();
-					clustPos_y_gem3 = cluster->local().y();
-					xyCharge_gem3 = cluster->charge();
-					eventID=int(cluster->timestamp());
-				}
-
 			}
 
 
@@ -163,34 +144,17 @@ StatusCode TreeWriter::run(const std::shared_ptr<Clipboard>& clipboard) {
 			LOG(DEBUG) << "evtID: " << int(track->timestamp());
 			eventID=int(track->timestamp());
 
-			if(strcmp(detector->getName().c_str(), "dut")==0){
-      }
-
-      if(strcmp(detector->getName().c_str(), "GEMXY1")==0){
 				auto tIntercept = detector->getIntercept(track.get());
-				trackIntercept_x_gem1 = tIntercept.X();
-				trackIntercept_y_gem1 = tIntercept.Y();
+				gem.trackIntercept_x = tIntercept.X();
+				gem.trackIntercept_y = tIntercept.Y();
 
 				// Track direction the same for all detectors, thus only
-				// adding it to the tree once. Same applies to intercept 
-				// at 800 mm
-				trackDirection = track->getDirection(detector->getName().c_str());
-				intercept_at_800mm = track->getIntercept(800);
-      }
-
-      if(strcmp(detector->getName().c_str(), "GEMXY2")==0){
-				auto tIntercept = detector->getIntercept(track.get());
-				trackIntercept_x_gem2 = tIntercept.X();
-				trackIntercept_y_gem2 = tIntercept.Y();
-      }
-
-      if(strcmp(detector->getName().c_str(), "GEMXY3")==0){
-				auto tIntercept = detector->getIntercept(track.get());
-				trackIntercept_x_gem3 = tIntercept.X();
-				trackIntercept_y_gem3 = tIntercept.Y();
-      }
-			
-			
+				// adding it to the tree once, for the first GEM. Same applies
+				// to intercept at 800 mm
+				if(&gem == &m_gems.front()) {
+					trackDirection = track->getDirection(detector->getName().c_str());
+					intercept_at_800mm = track->getIntercept(800);
+				}
     }
   }
 
@@ -23,6 +23,7 @@
 #include "core/module/Module.hpp"
 #include "objects/Track.hpp"
 #include "objects/Cluster.hpp"
+#include "tools/ChannelMap.h"
 
 namespace corryvreckan {
   /** @ingroup Modules
@@ -50,25 +51,19 @@ namespace corryvreckan {
       std::vector<std::string> m_objectList;
       std::map<std::string, Object*> m_objects;
 
-			double xyCharge_gem1;
-			double xyCharge_gem2;
-			double xyCharge_gem3;
-
-			double clustPos_x_gem1;
-			double clustPos_x_gem2;
-			double clustPos_x_gem3;
-
-			double clustPos_y_gem1;
-			double clustPos_y_gem2;
-			double clustPos_y_gem3;
-
-			double trackIntercept_x_gem1;
-			double trackIntercept_x_gem2;
-			double trackIntercept_x_gem3;
-
-			double trackIntercept_y_gem1;
-			double trackIntercept_y_gem2;
-			double trackIntercept_y_gem3;
+			// Output values of one XY GEM, its branches are named after the detector ID in the channel map
+			struct GemBranches {
+				std::shared_ptr<Detector> detector;
+				int det_id;
+				double xyCharge;
+				double clustPos_x;
+				double clustPos_y;
+				double trackIntercept_x;
+				double trackIntercept_y;
+			};
+
+			// Sorted by detector ID, the branches point into this vector so it is not resized after initialize()
+			std::vector<GemBranches> m_gems;
 
 			ROOT::Math::XYZPoint intercept_at_800mm;
 			
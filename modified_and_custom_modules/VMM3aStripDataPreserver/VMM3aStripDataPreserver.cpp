@@ -12,6 +12,8 @@
 #include "VMM3aStripDataPreserver.h"
 #include <TDirectory.h>
 
+#include <algorithm>
+
 using namespace corryvreckan;
 
 VMM3aStripDataPreserver::VMM3aStripDataPreserver(Configuration& config, std::vector<std::shared_ptr<Detector>> detectors)
@@ -21,6 +23,11 @@ VMM3aStripDataPreserver::VMM3aStripDataPreserver(Configuration& config, std::vec
       LOG(DEBUG) << "Input file name: " << m_inputFile;
       clustering_time = config_.get<double>("clustering_time");
       m_treefileName = config_.get<std::string>("output_tree_name");
+
+      config_.setDefault<int>("time_histogram_bins", 100000);
+      config_.setDefault<int>("time_histogram_range_entries", 1000);
+      time_histogram_bins = config_.get<int>("time_histogram_bins");
+      time_histogram_range_entries = static_cast<size_t>(std::max(config_.get<int>("time_histogram_range_entries"), 1));
     }
 
 
@@ -41,12 +48,13 @@ void VMM3aStripDataPreserver::initialize() {
       }
 
       local_directory->cd();
+      plot_directories[detectorID] = local_directory;
 
 
       LOG(DEBUG) << "Initialize ClusterLoaderVMM3a plots for " << detectorID;
 
       title = detectorID + " time0;time;entries";
-      clusterTime[detectorID] = new TH1F("time0", title.c_str(), 100000, 3000000000000, 6000000000000);
+      clusterTime[detectorID] = SparseHistogram("time0", title, time_histogram_bins, time_histogram_range_entries);
 
       title = detectorID + " X Strip cluster size;Size;entries";
       clusterSize_x[detectorID] = new TH1F("clusterSize_x", title.c_str(), 30, 0, 30);
@@ -70,34 +78,51 @@ void VMM3aStripDataPreserver::initialize() {
 
 
 
-    // For the clusters_detector ROOT file reading
-
-    data_file = TFile::Open(m_inputFile.c_str());
-    if (!data_file || data_file->IsZombie()){
-      LOG(DEBUG) << "Failed to open the data file: " << m_inputFile;
-      throw ModuleError("Error in opening TFile");
+    // For the clusters_detector ROOT file reading, or its column cache
+    m_useColumnCache = config_.has("column_cache");
+    if (m_useColumnCache){
+      column_cache.open(m_inputFile, config_.getPath("column_cache"));
+      number_of_entries = static_cast<Long64_t>(column_cache.size());
     }
+    else {
+      data_file = TFile::Open(m_inputFile.c_str());
+      if (!data_file || data_file->IsZombie()){
+        LOG(DEBUG) << "Failed to open the data file: " << m_inputFile;
+        throw ModuleError("Error in opening TFile");
+      }
 
-    data_tree = dynamic_cast<TTree*>(data_file->Get("clusters_detector"));
-    if (!data_tree) {
-        LOG(ERROR) << "Failed to retrieve TTree 'hits' from file";
-        throw ModuleError("Failed to retrieve TTree 'cluster_detector'");
-    }
+      data_tree = dynamic_cast<TTree*>(data_file->Get("clusters_detector"));
+      if (!data_tree) {
+          LOG(ERROR) << "Failed to retrieve TTree 'hits' from file";
+          throw ModuleError("Failed to retrieve TTree 'cluster_detector'");
+      }
+
+      number_of_entries = data_tree->GetEntries();
+      LOG(DEBUG) << "Number of entries in data_tree " << number_of_entries;
 
-    number_of_entries = data_tree->GetEntries();
-    LOG(DEBUG) << "Number of entries in data_tree " << number_of_entries;
+      // Only the branches stored in the output are read, ROOT skips the baskets of all others
+      data_tree->SetBranchStatus("*", false);
+      for (auto branch : {"det", "time0", "size0", "size1", "adcs0", "adcs1", "strips0", "strips1"}){
+        data_tree->SetBranchStatus(branch, true);
+      }
 
-    reader = new TTreeReader("clusters_detector", data_file);
+      // time0 and det are scanned in bulk for the track windows, only the matching entries go through the reader
+      time_index = TimeIndex(data_tree, "time0");
+      if (!time_index.isSorted()){
+        LOG(WARNING) << "Clusters in " << m_inputFile << " are not sorted in time0, clusters out of order are missed; the column_cache sorts them";
+      }
+      det_reader = BulkBranchReader<unsigned char>(data_tree, "det");
 
-    det = new TTreeReaderValue<unsigned char>(*reader, "det");
-    time0 = new TTreeReaderValue<double>(*reader, "time0");
-    size0 = new TTreeReaderValue<uint16_t>(*reader, "size0");
-    size1 = new TTreeReaderValue<uint16_t>(*reader, "size1");
+      reader = new TTreeReader("clusters_detector", data_file);
 
-    adcs0 = new TTreeReaderArray<double>(*reader, "adcs0");
-    adcs1 = new TTreeReaderArray<double>(*reader, "adcs1");
-    strips0 = new TTreeReaderArray<double>(*reader, "strips0");
-    strips1 = new TTreeReaderArray<double>(*reader, "strips1");
+      size0 = new TTreeReaderValue<uint16_t>(*reader, "size0");
+      size1 = new TTreeReaderValue<uint16_t>(*reader, "size1");
+
+      adcs0 = new TTreeReaderArray<double>(*reader, "adcs0");
+      adcs1 = new TTreeReaderArray<double>(*reader, "adcs1");
+      strips0 = new TTreeReaderArray<double>(*reader, "strips0");
+      strips1 = new TTreeReaderArray<double>(*reader, "strips1");
+    }
 
     // --- For the output TTree ---
 
@@ -119,131 +144,168 @@ void VMM3aStripDataPreserver::initialize() {
     m_outputTree->Branch("strips1", &vStrips1);
 
 
+    // Detector IDs in the clusters_detector TTree, from the channel_map or the GEMXY<n> names
+    auto channel_map = ChannelMap(config_, 1);
+    for (auto& detector : get_regular_detectors(true)) {
+      auto channel = channel_map.find(detector->getName());
+      if (!channel) {
+        LOG(WARNING) << "Detector " << detector->getName() << " not in the channel_map, its strip data is not stored";
+        continue;
+      }
+      m_detectorIDs.emplace_back(detector, channel->det_id);
+    }
+
+    // Lookup of the detectors by det for the sweep over the clusters
+    m_detectorSlots.fill(-1);
+    for (size_t slot=0; slot<m_detectorIDs.size(); slot++){
+      auto detID = m_detectorIDs[slot].second;
+      if (detID < 0 || detID > 255){
+        throw InvalidValueError(config_, "channel_map", "det of " + m_detectorIDs[slot].first->getName() + " is not between 0 and 255");
+      }
+      m_detectorSlots[static_cast<size_t>(detID)] = static_cast<int>(slot);
+
+      auto detectorID = m_detectorIDs[slot].first->getName();
+      m_slotPlots.push_back({clusterSize_x[detectorID], clusterSize_y[detectorID], &clusterTime[detectorID], stripCharge_x[detectorID],
+                             stripCharge_y[detectorID], stripPos_x[detectorID], stripPos_y[detectorID]});
+    }
+
     // Initialise member variables
     m_entry = 0;
     number_of_tracks = 0;
-    first_entry_index = 0;
 }
 
 StatusCode VMM3aStripDataPreserver::run(const std::shared_ptr<Clipboard>& clipboard) {
 
-    reader->SetLocalEntry(m_entry);
-
-    // Get tracks from the clipboard
+    // Get tracks from the clipboard, in time order for the sweep over the time ordered clusters
     auto tracks = clipboard->getData<Track>();
+    std::sort(tracks.begin(), tracks.end(), [](const auto& a, const auto& b) { return a->timestamp() < b->timestamp(); });
 
-    // If there are tracks start to look for the strip data
-    if (!tracks.empty()){
-
-      for (auto& track : tracks){
-
-
-
-        while(reader->Next()){
-
-          // Iterate until we get an entry inside the set time
-          // interval (clustering_time), when found store the index
-          if(**time0 > (track->timestamp() - clustering_time/2)){
-            m_entry = reader->GetCurrentEntry();
-            LOG(DEBUG) << "Found first entry of the track: m_entry = " << m_entry;
-            break;
-            }
-
-          } // while(reader.Next())
-
-				// Store the index
-				first_entry_index = m_entry;
-
-				LOG(DEBUG) << "track timestamp = " << std::fixed << std::setprecision(15) << track->timestamp();
-				LOG(DEBUG) << "time0** - (track->timestamp() - clustering_time/2) = " << **time0 - (track->timestamp() - clustering_time/2);
-
-
-        for (auto& detector : get_regular_detectors(true)) {
-
-          // Restart the loop for each detector
-          m_entry = first_entry_index;
-					LOG(DEBUG) << "first_entry_index  =  " << first_entry_index << ",  m_entry  =  " << m_entry;
-
-
-          auto detectorID = detector->getName();
-
-          // Change the detector names to match the corryvreckan geometry file!
-          if(strcmp(detectorID.c_str(), "GEMXY1")==0) detID=1;
-          if(strcmp(detectorID.c_str(), "GEMXY2")==0) detID=2;
-          if(strcmp(detectorID.c_str(), "GEMXY3")==0) detID=3;
-          if(strcmp(detectorID.c_str(), "GEMXY4")==0) detID=4;
-
-					LOG(DEBUG) << "detectorID  =   " << detectorID << ",  detID  =  " << detID << ",  time0  =  " << **time0;
-
-          // Loop over hits used in the clustering
-          while(true){
-            
-						reader->SetLocalEntry(m_entry);
-
-						// Clear containers
-						vADCS0.clear();
-						vADCS1.clear();
-						vStrips0.clear();
-						vStrips1.clear();
-
-            LOG(DEBUG) << "Starting the loop over data";
-            if (**time0 > (track->timestamp() + clustering_time/2) || m_entry > number_of_entries){
-              LOG(DEBUG) << "Ending the loop over data";
-              break;}
-
-            // If correct detector and inside the time interval fill the histograms
-            if (static_cast<int>(**det) == detID){
-              LOG(DEBUG) << "Found track:  time0 = " << std::fixed << std::setprecision(15) << **time0 << ",  det = " << static_cast<int>(**det) << ",  size0 = " << **size0 << ",  size1 = " << **size1;
-              clusterSize_x[detectorID]->Fill(**size0);
-              clusterSize_y[detectorID]->Fill(**size1);
-              clusterTime[detectorID]->Fill(**time0);
-              treeSize0 = **size0;
-              treeSize1 = **size1;
-              treeTime = **time0;
-              treeDetID = **det;
+    for (auto& track : tracks){
+      auto window_begin = track->timestamp() - clustering_time/2;
+      auto window_end = track->timestamp() + clustering_time/2;
+      LOG(DEBUG) << "track timestamp = " << std::fixed << std::setprecision(15) << track->timestamp();
 
+      // Clusters before the window of this track are not in the windows of the later tracks either
+      while (!m_window.empty() && !(m_window.front().time > window_begin)){
+        m_window.pop_front();
+      }
 
-              for (size_t i=0; i<adcs0->GetSize(); i++){
-                stripCharge_x[detectorID]->Fill(adcs0->At(i));
-                stripPos_x[detectorID]->Fill(strips0->At(i));
-                vADCS0.push_back(adcs0->At(i));
-                vStrips0.push_back(strips0->At(i));
-              }
+      // Jump over the entries before the window, then add the clusters of the selected detectors up to its end.
+      // Every entry is looked at once, however many tracks and detectors there are
+      if (m_window.empty() && m_entry < number_of_entries){
+        m_entry = FindFirstAfter(m_entry, window_begin);
+      }
+      for (; m_entry < number_of_entries; m_entry++){
+        auto time = EntryTime(m_entry);
+        if (time > window_end) break;
 
-              for (size_t j=0; j<adcs1->GetSize(); j++){
-                stripCharge_y[detectorID]->Fill(adcs1->At(j));
-                stripPos_y[detectorID]->Fill(strips1->At(j));
-                vADCS1.push_back(adcs1->At(j));
-                vStrips1.push_back(strips1->At(j));
-							}
+        auto slot = m_detectorSlots[EntryDet(m_entry)];
+        if (slot >= 0 && time > window_begin){
+          m_window.push_back({m_entry, time, static_cast<size_t>(slot)});
+        }
+      }
 
-          		
-							m_outputTree->Fill();
-            } // if **det==detectorID
+      for (const auto& cluster : m_window){
+        if (cluster.time > window_end) break;
+        StoreCluster(cluster);
+      }
+    } // for(track : tracks)
 
-            m_entry++;
+    if (!tracks.empty()){
+      number_of_tracks++;
+      LOG(DEBUG) << "number of tracks  =  " << number_of_tracks;
+    }
 
-          } // while(true)
+    // End the run if all entries read
+    if (m_entry >= number_of_entries && m_window.empty()){return StatusCode::EndRun;}
 
-					
-        }
-      } // for(track : tracks)
 
-			number_of_tracks++;
-			LOG(DEBUG) << "number of tracks  =  " << number_of_tracks;
+    // Return value telling analysis to keep running
+    return StatusCode::Success;
+}
 
-    } // if(!tracks.empty())
+double VMM3aStripDataPreserver::EntryTime(Long64_t entry) {
+    return m_useColumnCache ? column_cache.time0(static_cast<size_t>(entry)) : time_index.getTime(entry);
+}
 
+unsigned char VMM3aStripDataPreserver::EntryDet(Long64_t entry) {
+    if (m_useColumnCache){
+      return column_cache.det(static_cast<size_t>(entry));
+    }
+    if (entry < det_block_first || entry >= det_block_first + static_cast<Long64_t>(det_block.size())){
+      det_block.clear();
+      det_block_first = entry;
+      det_reader.read(entry, entry + 4096, det_block);
+    }
+    return det_block[static_cast<size_t>(entry - det_block_first)];
+}
 
-    // End the run if all entries read
-    if (m_entry > number_of_entries){return StatusCode::EndRun;}
+Long64_t VMM3aStripDataPreserver::FindFirstAfter(Long64_t begin, double time) {
+    if (m_useColumnCache){
+      return static_cast<Long64_t>(column_cache.findWindowEnd(static_cast<size_t>(begin), time, 0));
+    }
+    return time_index.findWindowEnd(begin, time, 0);
+}
 
+void VMM3aStripDataPreserver::StoreCluster(const WindowCluster& cluster) {
+    auto& plots = m_slotPlots[cluster.slot];
+
+    vADCS0.clear();
+    vADCS1.clear();
+    vStrips0.clear();
+    vStrips1.clear();
+
+    // The sizes and strip arrays are only read for the clusters of the tracks
+    if (m_useColumnCache){
+      auto entry = static_cast<size_t>(cluster.entry);
+      treeSize0 = column_cache.size0(entry);
+      treeSize1 = column_cache.size1(entry);
+      auto x_strips = column_cache.strips0(entry);
+      auto y_strips = column_cache.strips1(entry);
+      vADCS0.assign(x_strips.adcs, x_strips.adcs + x_strips.size);
+      vStrips0.assign(x_strips.strips, x_strips.strips + x_strips.size);
+      vADCS1.assign(y_strips.adcs, y_strips.adcs + y_strips.size);
+      vStrips1.assign(y_strips.strips, y_strips.strips + y_strips.size);
+    }
+    else {
+      reader->SetLocalEntry(cluster.entry);
+      treeSize0 = **size0;
+      treeSize1 = **size1;
+      for (size_t i=0; i<adcs0->GetSize(); i++){
+        vADCS0.push_back(adcs0->At(i));
+        vStrips0.push_back(strips0->At(i));
+      }
+      for (size_t j=0; j<adcs1->GetSize(); j++){
+        vADCS1.push_back(adcs1->At(j));
+        vStrips1.push_back(strips1->At(j));
+      }
+    }
+    treeTime = cluster.time;
+    treeDetID = static_cast<unsigned char>(m_detectorIDs[cluster.slot].second);
+    LOG(DEBUG) << "Found track:  time0 = " << std::fixed << std::setprecision(15) << treeTime << ",  det = " << static_cast<int>(treeDetID) << ",  size0 = " << treeSize0 << ",  size1 = " << treeSize1;
+
+    plots.clusterSize_x->Fill(treeSize0);
+    plots.clusterSize_y->Fill(treeSize1);
+    plots.clusterTime->Fill(treeTime);
+    for (size_t i=0; i<vADCS0.size(); i++){
+      plots.stripCharge_x->Fill(vADCS0[i]);
+      plots.stripPos_x->Fill(vStrips0[i]);
+    }
+    for (size_t j=0; j<vADCS1.size(); j++){
+      plots.stripCharge_y->Fill(vADCS1[j]);
+      plots.stripPos_y->Fill(vStrips1[j]);
+    }
 
-    // Return value telling analysis to keep running
-    return StatusCode::Success;
+    m_outputTree->Fill();
 }
 
 void VMM3aStripDataPreserver::finalize(const std::shared_ptr<ReadonlyClipboard>&) { LOG(DEBUG) << "Analysed " << number_of_tracks << " tracks";
+
+  // The time histograms are booked as TH1F in the plot directories now that their range is known
+  for (auto& [detectorID, histogram] : clusterTime){
+    plot_directories[detectorID]->cd();
+    histogram.toTH1F();
+  }
 		
   // Writing out outputfile
   m_outputFile->Write();
@@ -17,6 +17,8 @@
 #include <TTreeReader.h>
 #include <TTreeReaderValue.h>
 #include <TTreeReaderArray.h>
+#include <array>
+#include <deque>
 #include <iostream>
 
 #include "core/module/Module.hpp"
@@ -24,6 +26,11 @@
 #include "objects/Cluster.hpp"
 #include "objects/Pixel.hpp"
 #include "objects/Track.hpp"
+#include "tools/BulkBranchReader.h"
+#include "tools/ChannelMap.h"
+#include "tools/SparseHistogram.h"
+#include "tools/TimeIndex.h"
+#include "tools/VMM3aColumnCache.h"
 
 namespace corryvreckan {
     /** @ingroup Modules
@@ -58,21 +65,64 @@ namespace corryvreckan {
         void finalize(const std::shared_ptr<ReadonlyClipboard>& clipboard) override;
 
     private:
+        // Cluster of a selected detector inside the time window of the current track
+        struct WindowCluster {
+            Long64_t entry;
+            double time;
+            size_t slot;
+        };
+
+        // Plots of a selected detector
+        struct StripPlots {
+            TH1F* clusterSize_x;
+            TH1F* clusterSize_y;
+            SparseHistogram* clusterTime;
+            TH1F* stripCharge_x;
+            TH1F* stripCharge_y;
+            TH1F* stripPos_x;
+            TH1F* stripPos_y;
+        };
+
+        // Time and det of an entry, from the column cache or the tree
+        double EntryTime(Long64_t entry);
+        unsigned char EntryDet(Long64_t entry);
+        Long64_t FindFirstAfter(Long64_t begin, double time);
+
+        // Fill the plots and the output tree with a cluster of the window
+        void StoreCluster(const WindowCluster& cluster);
+
         Long64_t m_entry;
-        Long64_t first_entry_index;
         Long64_t number_of_entries;
         Long64_t number_of_tracks;
         std::string m_inputFile;
         std::string title;
         double clustering_time;
-        int detID;
+
+        // Detectors with their ID in the clusters_detector TTree, resolved in initialize()
+        std::vector<std::pair<std::shared_ptr<Detector>, int>> m_detectorIDs;
+
+        // Slot in m_detectorIDs and m_slotPlots of every det value, -1 for detectors that are not stored
+        std::array<int, 256> m_detectorSlots;
+        std::vector<StripPlots> m_slotPlots;
+
+        // Clusters of the selected detectors from the start of the window of the last track on, entries before m_entry
+        // have been added to it
+        std::deque<WindowCluster> m_window;
+
+        // Time sorted columns of the clusters_detector tree, used instead of the tree if column_cache is set
+        bool m_useColumnCache{false};
+        VMM3aColumnCache column_cache;
 
         TFile* data_file;
         TTree* data_tree;
 
+        // Columns of time0 and det for the selection of the entries of the tracks, det is read ahead in blocks
+        TimeIndex time_index;
+        BulkBranchReader<unsigned char> det_reader;
+        std::vector<unsigned char> det_block;
+        Long64_t det_block_first{0};
+
         TTreeReader *reader;
-        TTreeReaderValue<unsigned char> *det;
-        TTreeReaderValue<double> *time0;
         TTreeReaderValue<uint16_t> *size0;
         TTreeReaderValue<uint16_t> *size1;
 
@@ -83,7 +133,11 @@ namespace corryvreckan {
 
         std::map<std::string, TH1F*> clusterSize_x;
         std::map<std::string, TH1F*> clusterSize_y;
-        std::map<std::string, TH1F*> clusterTime;
+        // The time of the whole run only takes memory for the filled bins, it becomes a TH1F in finalize
+        std::map<std::string, SparseHistogram> clusterTime;
+        std::map<std::string, TDirectory*> plot_directories;
+        int time_histogram_bins;
+        size_t time_histogram_range_entries;
         std::map<std::string, TH1F*> stripCharge_x;
         std::map<std::string, TH1F*> stripCharge_y;
         std::map<std::string, TH1F*> stripPos_x;
@@ -0,0 +1,110 @@
+/**
+ * @file
+ * @brief Minimum cost assignment between two sets of objects
+ *
+ * @copyright Copyright (c) 2020 CERN and the Corryvreckan authors.
+ * This software is distributed under the terms of the MIT License, copied verbatim in the file "LICENSE.md".
+ * In applying this license, CERN does not waive the privileges and immunities granted to it by virtue of its status as an
+ * Intergovernmental Organization or submit itself to any jurisdiction.
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef CORRYVRECKAN_ASSIGNMENT_H
+#define CORRYVRECKAN_ASSIGNMENT_H
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <vector>
+
+namespace corryvreckan {
+    /**
+     * @brief Pair rows and columns of a cost matrix such that the summed cost of the pairs is minimal
+     *
+     * Hungarian algorithm with potentials, O(n^2 m) for n = min(rows, cols) and m = max(rows, cols). The matrix can be
+     * rectangular, then min(rows, cols) pairs are made and the remaining rows or columns stay unassigned.
+     *
+     * @param cost Row-major cost matrix
+     * @param rows Number of rows
+     * @param cols Number of columns
+     * @return Assigned column of each row, -1 for unassigned rows
+     */
+    inline std::vector<int> minimumCostAssignment(const std::vector<double>& cost, size_t rows, size_t cols) {
+        std::vector<int> assignment(rows, -1);
+        if(rows == 0 || cols == 0) {
+            return assignment;
+        }
+
+        // The algorithm needs at most as many rows as columns, otherwise work on the transposed matrix
+        bool transposed = rows > cols;
+        size_t n = transposed ? cols : rows;
+        size_t m = transposed ? rows : cols;
+        auto a = [&](size_t i, size_t j) {
+            return transposed ? cost[(j - 1) * cols + (i - 1)] : cost[(i - 1) * cols + (j - 1)];
+        };
+
+        const double inf = std::numeric_limits<double>::infinity();
+        std::vector<double> u(n + 1, 0), v(m + 1, 0), minv(m + 1);
+        std::vector<size_t> p(m + 1, 0), way(m + 1, 0);
+        std::vector<char> used(m + 1);
+
+        for(size_t i = 1; i <= n; i++) {
+            p[0] = i;
+            size_t j0 = 0;
+            std::fill(minv.begin(), minv.end(), inf);
+            std::fill(used.begin(), used.end(), 0);
+
+            // Grow an alternating tree from row i until it reaches a free column
+            do {
+                used[j0] = 1;
+                size_t i0 = p[j0];
+                size_t j1 = 0;
+                double delta = inf;
+                for(size_t j = 1; j <= m; j++) {
+                    if(used[j]) {
+                        continue;
+                    }
+                    double current = a(i0, j) - u[i0] - v[j];
+                    if(current < minv[j]) {
+                        minv[j] = current;
+                        way[j] = j0;
+                    }
+                    if(minv[j] < delta) {
+                        delta = minv[j];
+                        j1 = j;
+                    }
+                }
+                for(size_t j = 0; j <= m; j++) {
+                    if(used[j]) {
+                        u[p[j]] += delta;
+                        v[j] -= delta;
+                    } else {
+                        minv[j] -= delta;
+                    }
+                }
+                j0 = j1;
+            } while(p[j0] != 0);
+
+            // Flip the augmenting path
+            do {
+                size_t j1 = way[j0];
+                p[j0] = p[j1];
+                j0 = j1;
+            } while(j0 != 0);
+        }
+
+        for(size_t j = 1; j <= m; j++) {
+            if(p[j] == 0) {
+                continue;
+            }
+            if(transposed) {
+                assignment[j - 1] = static_cast<int>(p[j] - 1);
+            } else {
+                assignment[p[j] - 1] = static_cast<int>(j - 1);
+            }
+        }
+        return assignment;
+    }
+
+} // namespace corryvreckan
+#endif // CORRYVRECKAN_ASSIGNMENT_H
@@ -0,0 +1,159 @@
+/**
+ * @file
+ * @brief Asynchronous prefetching and decompression for the ROOT file loaders
+ *
+ * @copyright Copyright (c) 2020 CERN and the Corryvreckan authors.
+ * This software is distributed under the terms of the MIT License, copied verbatim in the file "LICENSE.md".
+ * In applying this license, CERN does not waive the privileges and immunities granted to it by virtue of its status as an
+ * Intergovernmental Organization or submit itself to any jurisdiction.
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef CORRYVRECKAN_ASYNC_INPUT_H
+#define CORRYVRECKAN_ASYNC_INPUT_H
+
+#include <TEnv.h>
+#include <TROOT.h>
+#include <TTree.h>
+#include <TTreeCacheUnzip.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <mutex>
+#include <string>
+
+#include "core/config/Configuration.hpp"
+#include "core/utils/log.h"
+
+namespace corryvreckan {
+    /**
+     * @brief Settings of the asynchronous input stage, read from the module configuration
+     *
+     * When enabled, the baskets of the input tree are read ahead into a TTreeCache of the configured size. The next
+     * cache block is fetched by ROOT's prefetching thread and the cached baskets are decompressed by background tasks,
+     * while the module reconstructs the current event.
+     */
+    struct AsyncInputSettings {
+        bool enabled{false};
+        Long64_t cache_size{0};
+        unsigned int unzip_threads{0};
+
+        explicit AsyncInputSettings(Configuration& config) {
+            config.setDefault<bool>("async_input", false);
+            config.setDefault<int>("input_cache_size", 100);
+            config.setDefault<int>("input_unzip_threads", 0);
+
+            enabled = config.get<bool>("async_input");
+            cache_size = static_cast<Long64_t>(config.get<int>("input_cache_size")) * 1024 * 1024;
+            unzip_threads = static_cast<unsigned int>(std::max(0, config.get<int>("input_unzip_threads")));
+        }
+    };
+
+    /**
+     * @brief Enable the background prefetching, has to be called before the input file is opened
+     *
+     * The prefetching, the parallel unzipping and ROOT's implicit multi-threading are settings of the whole process, so
+     * they are only changed by the first module asking for them. An implicit multi-threading that is already enabled is
+     * kept as it is.
+     */
+    inline void prepareAsyncInput(const AsyncInputSettings& settings) {
+        if(!settings.enabled) {
+            return;
+        }
+
+        static std::once_flag global_settings;
+        static unsigned int unzip_threads = 0;
+        std::call_once(global_settings, [&settings]() {
+            LOG(WARNING) << "async_input enables ROOT's asynchronous prefetching and parallel unzipping for the whole process, "
+                         << "they apply to the ROOT files of all modules";
+
+            // Read the next cache block in ROOT's prefetching thread
+            gEnv->SetValue("TFile.AsyncPrefetching", 1);
+
+            // Decompress the cached baskets in background tasks, zero threads lets ROOT use all cores
+            unzip_threads = settings.unzip_threads;
+            if(ROOT::IsImplicitMTEnabled()) {
+                LOG(WARNING) << "ROOT implicit multi-threading is already enabled, it is kept as configured and "
+                             << "input_unzip_threads is not used";
+            } else {
+                ROOT::EnableImplicitMT(unzip_threads);
+            }
+            TTreeCacheUnzip::SetParallelUnzip(TTreeCacheUnzip::kEnable);
+        });
+
+        if(settings.unzip_threads != unzip_threads) {
+            LOG(WARNING) << "ROOT implicit multi-threading was already set up for input_unzip_threads = " << unzip_threads
+                         << ", input_unzip_threads = " << settings.unzip_threads << " is not used";
+        }
+    }
+
+    /**
+     * @brief Attach a read-ahead cache with all branches to an input tree
+     */
+    inline void configureAsyncInput(TTree* tree, const AsyncInputSettings& settings) {
+        if(!settings.enabled) {
+            return;
+        }
+
+        tree->SetCacheSize(settings.cache_size);
+        tree->AddBranchToCache("*", true);
+        tree->StopCacheLearningPhase();
+
+        LOG(INFO) << "Asynchronous input for tree " << tree->GetName() << " with " << (settings.cache_size / 1024 / 1024)
+                  << " MB read-ahead cache";
+    }
+
+    /**
+     * @brief Accumulates the time a module is blocked waiting for its input
+     */
+    class InputStallTimer {
+
+    public:
+        // Measures the time from construction to destruction
+        class Scope {
+        public:
+            explicit Scope(InputStallTimer& timer) : m_timer(timer), m_start(std::chrono::steady_clock::now()) {}
+            ~Scope() { m_timer.add(std::chrono::steady_clock::now() - m_start); }
+
+            Scope(const Scope&) = delete;
+            Scope& operator=(const Scope&) = delete;
+
+        private:
+            InputStallTimer& m_timer;
+            std::chrono::steady_clock::time_point m_start;
+        };
+
+        Scope measure() { return Scope(*this); }
+
+        /**
+         * @brief Log the stall statistics
+         * @param name Name of the module instance
+         * @param events Number of processed events
+         */
+        void report(const std::string& name, long events) const {
+            if(m_reads == 0) {
+                return;
+            }
+            LOG(STATUS) << name << " waited " << m_total << " s for input in " << m_reads << " reads: " << std::fixed
+                        << std::setprecision(1) << (1e6 * m_total / static_cast<double>(std::max(events, 1L)))
+                        << " us per event, longest stall " << (1e3 * m_max) << " ms";
+        }
+
+        double getTotal() const { return m_total; }
+
+    private:
+        void add(std::chrono::steady_clock::duration duration) {
+            auto seconds = std::chrono::duration<double>(duration).count();
+            m_total += seconds;
+            m_max = std::max(m_max, seconds);
+            m_reads++;
+        }
+
+        double m_total{0};
+        double m_max{0};
+        long m_reads{0};
+    };
+
+} // namespace corryvreckan
+#endif // CORRYVRECKAN_ASYNC_INPUT_H
@@ -0,0 +1,123 @@
+/**
+ * @file
+ * @brief Reading of simple TTree branches into contiguous arrays
+ *
+ * @copyright Copyright (c) 2020 CERN and the Corryvreckan authors.
+ * This software is distributed under the terms of the MIT License, copied verbatim in the file "LICENSE.md".
+ * In applying this license, CERN does not waive the privileges and immunities granted to it by virtue of its status as an
+ * Intergovernmental Organization or submit itself to any jurisdiction.
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef CORRYVRECKAN_BULK_BRANCH_READER_H
+#define CORRYVRECKAN_BULK_BRANCH_READER_H
+
+#include <TBranch.h>
+#include <TBufferFile.h>
+#include <TTree.h>
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "core/module/exceptions.h"
+
+namespace corryvreckan {
+    /**
+     * @brief Reads consecutive entries of a branch with one scalar leaf into a contiguous array
+     *
+     * Whole baskets are decoded at once with ROOT's bulk I/O and copied into the column, the last decoded basket is kept
+     * so consecutive reads from the same basket do not decompress it again. Branches that do not support bulk reading
+     * fall back to reading one entry at a time. The element type has to match the size of the leaf type, e.g. a bool
+     * branch can be read as unsigned char.
+     */
+    template <typename T> class BulkBranchReader {
+
+    public:
+        BulkBranchReader() = default;
+
+        BulkBranchReader(TTree* tree, const std::string& name) : m_branch(tree->GetBranch(name.c_str())) {
+            if(m_branch == nullptr) {
+                throw ModuleError("Branch '" + name + "' not found in TTree '" + tree->GetName() + "'");
+            }
+            m_buffer = std::make_unique<TBufferFile>(TBuffer::kWrite, 32000);
+            m_entries = m_branch->GetEntries();
+            m_bulk = m_branch->GetBulkRead().SupportsBulkRead();
+        }
+
+        /**
+         * @brief Append the entries [first, last) of the branch to a column
+         */
+        void read(Long64_t first, Long64_t last, std::vector<T>& column) {
+            last = std::min(last, m_entries);
+            if(first >= last) {
+                return;
+            }
+
+            if(!m_bulk) {
+                readEntries(first, last, column);
+                return;
+            }
+
+            auto entry = first;
+            while(entry < last) {
+                if(entry < m_basketFirst || entry >= m_basketFirst + m_basketCount) {
+                    if(!loadBasket(entry)) {
+                        // Leaf type not supported by the bulk API, use the slow path from here on
+                        m_bulk = false;
+                        readEntries(entry, last, column);
+                        return;
+                    }
+                }
+
+                auto data = reinterpret_cast<const T*>(m_buffer->GetCurrent());
+                auto begin = entry - m_basketFirst;
+                auto end = std::min(last, m_basketFirst + m_basketCount) - m_basketFirst;
+                column.insert(column.end(), data + begin, data + end);
+                entry = m_basketFirst + end;
+            }
+        }
+
+        Long64_t getEntries() const { return m_entries; }
+
+    private:
+        // Decode the basket containing an entry. Reading always starts at the first entry of the basket, so it does not
+        // matter whether the bulk API returns the data from the requested entry or from the start of the basket.
+        bool loadBasket(Long64_t entry) {
+            auto basket_entry = m_branch->GetBasketEntry();
+            auto baskets = m_branch->GetWriteBasket() + 1;
+            auto basket = std::upper_bound(basket_entry, basket_entry + baskets, entry) - 1;
+
+            m_basketFirst = *basket;
+            m_basketCount = m_branch->GetBulkRead().GetBulkEntries(m_basketFirst, *m_buffer);
+            if(m_basketCount <= 0) {
+                m_basketFirst = -1;
+                m_basketCount = 0;
+                return false;
+            }
+            return true;
+        }
+
+        void readEntries(Long64_t first, Long64_t last, std::vector<T>& column) {
+            m_branch->SetAddress(&m_value);
+            for(auto entry = first; entry < last; entry++) {
+                m_branch->GetEntry(entry);
+                column.push_back(m_value);
+            }
+        }
+
+        TBranch* m_branch{nullptr};
+        Long64_t m_entries{0};
+        bool m_bulk{false};
+
+        std::unique_ptr<TBufferFile> m_buffer;
+        Long64_t m_basketFirst{-1};
+        Long64_t m_basketCount{0};
+
+        T m_value{};
+    };
+
+} // namespace corryvreckan
+#endif // CORRYVRECKAN_BULK_BRANCH_READER_H
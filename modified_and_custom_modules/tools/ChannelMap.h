@@ -0,0 +1,139 @@
+/**
+ * @file
+ * @brief Mapping of detector names to the detector and plane IDs of the input trees
+ *
+ * @copyright Copyright (c) 2020 CERN and the Corryvreckan authors.
+ * This software is distributed under the terms of the MIT License, copied verbatim in the file "LICENSE.md".
+ * In applying this license, CERN does not waive the privileges and immunities granted to it by virtue of its status as an
+ * Intergovernmental Organization or submit itself to any jurisdiction.
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef CORRYVRECKAN_CHANNEL_MAP_H
+#define CORRYVRECKAN_CHANNEL_MAP_H
+
+#include <algorithm>
+#include <cctype>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "core/config/Configuration.hpp"
+#include "core/config/exceptions.h"
+#include "core/module/exceptions.h"
+#include "core/utils/log.h"
+
+namespace corryvreckan {
+    /**
+     * @brief Resolves the corryvreckan detector names to the (detID, planeID, axis) used in the input trees
+     *
+     * Entries are read from the `channel_map` key of the module configuration, each one of the form
+     * `"name:detID"` for a detector reading both strip planes, or `"name:detID:planeID"` for a single strip plane with
+     * plane 0 the X and plane 1 the Y strips. Names not listed there follow the naming convention of the geometry files,
+     * GEMX<n> and GEMY<n> for single strip planes and GEMXY<n> for XY detectors, where the first GEM gets the ID given by
+     * the module. The names are resolved once in initialize(), the event loop only compares the resulting integers.
+     */
+    class ChannelMap {
+
+    public:
+        enum class Axis { X, Y, XY };
+
+        struct Channel {
+            int det_id;
+            // -1 for detectors reading both strip planes
+            int plane_id;
+            Axis axis;
+        };
+
+        ChannelMap() = default;
+
+        /**
+         * @brief Read the explicit entries of the channel map from the module configuration
+         * @param config Configuration of the module
+         * @param first_id Detector ID of GEM number 1 in the input tree, for names following the naming convention
+         */
+        ChannelMap(const Configuration& config, int first_id) : m_firstID(first_id) {
+            if(!config.has("channel_map")) {
+                return;
+            }
+
+            for(const auto& entry : config.getArray<std::string>("channel_map")) {
+                std::vector<std::string> fields;
+                std::stringstream stream(entry);
+                std::string field;
+                while(std::getline(stream, field, ':')) {
+                    fields.push_back(field);
+                }
+
+                if(fields.size() < 2 || fields.size() > 3 || fields[0].empty()) {
+                    throw InvalidValueError(
+                        config, "channel_map", "entry '" + entry + "' is not of the form name:det[:plane]");
+                }
+
+                Channel channel{};
+                try {
+                    channel.det_id = std::stoi(fields[1]);
+                    channel.plane_id = (fields.size() == 3 ? std::stoi(fields[2]) : -1);
+                } catch(std::logic_error&) {
+                    throw InvalidValueError(config, "channel_map", "entry '" + entry + "' has a non-numeric ID");
+                }
+                if(channel.plane_id < -1 || channel.plane_id > 1) {
+                    throw InvalidValueError(config, "channel_map", "entry '" + entry + "' has plane ID other than 0 or 1");
+                }
+                channel.axis = toAxis(channel.plane_id);
+
+                m_channels[fields[0]] = channel;
+                LOG(DEBUG) << "Channel map: " << fields[0] << " -> det " << channel.det_id << ", plane " << channel.plane_id;
+            }
+        }
+
+        /**
+         * @brief Look up a detector, first in the configured entries and then by the naming convention
+         */
+        std::optional<Channel> find(const std::string& name) const {
+            auto it = m_channels.find(name);
+            if(it != m_channels.end()) {
+                return it->second;
+            }
+
+            // GEMXY has to be tried before GEMX
+            for(const auto& prefix : {std::make_pair("GEMXY", -1), std::make_pair("GEMX", 0), std::make_pair("GEMY", 1)}) {
+                std::string tag = prefix.first;
+                if(name.size() <= tag.size() || name.compare(0, tag.size(), tag) != 0) {
+                    continue;
+                }
+
+                auto number = name.substr(tag.size());
+                auto is_digit = [](unsigned char c) { return std::isdigit(c) != 0; };
+                if(number.size() > 4 || !std::all_of(number.begin(), number.end(), is_digit)) {
+                    continue;
+                }
+                return Channel{std::stoi(number) - 1 + m_firstID, prefix.second, toAxis(prefix.second)};
+            }
+
+            return std::nullopt;
+        }
+
+        /**
+         * @brief Look up a detector, throws if the name is neither in the channel map nor follows the naming convention
+         */
+        Channel get(const std::string& name) const {
+            auto channel = find(name);
+            if(!channel) {
+                throw ModuleError("Detector " + name +
+                                  " is not in the channel_map and does not follow the GEMX<n>, GEMY<n> or GEMXY<n> naming");
+            }
+            return *channel;
+        }
+
+    private:
+        static Axis toAxis(int plane_id) { return plane_id == 0 ? Axis::X : (plane_id == 1 ? Axis::Y : Axis::XY); }
+
+        int m_firstID{1};
+        std::map<std::string, Channel> m_channels;
+    };
+
+} // namespace corryvreckan
+#endif // CORRYVRECKAN_CHANNEL_MAP_H
@@ -0,0 +1,184 @@
+/**
+ * @file
+ * @brief Precomputed geometry and resolution of a detector for making clusters
+ *
+ * @copyright Copyright (c) 2020 CERN and the Corryvreckan authors.
+ * This software is distributed under the terms of the MIT License, copied verbatim in the file "LICENSE.md".
+ * In applying this license, CERN does not waive the privileges and immunities granted to it by virtue of its status as an
+ * Intergovernmental Organization or submit itself to any jurisdiction.
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef CORRYVRECKAN_DETECTOR_GEOMETRY_CACHE_H
+#define CORRYVRECKAN_DETECTOR_GEOMETRY_CACHE_H
+
+#include <Math/Point3D.h>
+#include <Math/Vector2D.h>
+#include <TMatrixD.h>
+
+#include <array>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "core/detector/Detector.hpp"
+
+namespace corryvreckan {
+    /**
+     * @brief Geometry of a detector reduced to a few coefficients, built once in initialize()
+     *
+     * Both the strip/pixel to local position conversion and the local to global transformation of a detector are affine,
+     * so they are measured once by transforming the origin and the unit vectors, and applied as a handful of multiply
+     * adds afterwards. localToGlobal() converts all clusters of an event at once over plain arrays, which the compiler
+     * vectorises.
+     *
+     * The spatial resolution of our detectors does not depend on the position. It is checked at the corners and the
+     * centre of the matrix when the cache is built, and if it is the same everywhere the resolution and its global
+     * matrix are stored once. Otherwise every lookup goes to the detector.
+     *
+     * The alignment is taken at the time the cache is built, it has to be rebuilt if the alignment changes.
+     */
+    class DetectorGeometryCache {
+
+    public:
+        DetectorGeometryCache() = default;
+
+        explicit DetectorGeometryCache(std::shared_ptr<Detector> detector) : m_detector(std::move(detector)) {
+            // Local position of the strips/pixels, z is zero on the detector plane
+            auto origin = m_detector->getLocalPosition(0, 0);
+            auto column = m_detector->getLocalPosition(1, 0);
+            auto row = m_detector->getLocalPosition(0, 1);
+            m_local = {origin.x(),
+                       column.x() - origin.x(),
+                       row.x() - origin.x(),
+                       origin.y(),
+                       column.y() - origin.y(),
+                       row.y() - origin.y()};
+
+            // Local to global, the columns of the rotation are the transformed unit vectors
+            auto offset = m_detector->localToGlobal(ROOT::Math::XYZPoint(0, 0, 0));
+            auto ex = m_detector->localToGlobal(ROOT::Math::XYZPoint(1, 0, 0));
+            auto ey = m_detector->localToGlobal(ROOT::Math::XYZPoint(0, 1, 0));
+            auto ez = m_detector->localToGlobal(ROOT::Math::XYZPoint(0, 0, 1));
+            m_global = {offset.x(),
+                        ex.x() - offset.x(),
+                        ey.x() - offset.x(),
+                        ez.x() - offset.x(),
+                        offset.y(),
+                        ex.y() - offset.y(),
+                        ey.y() - offset.y(),
+                        ez.y() - offset.y(),
+                        offset.z(),
+                        ex.z() - offset.z(),
+                        ey.z() - offset.z(),
+                        ez.z() - offset.z()};
+
+            m_resolution = m_detector->getSpatialResolution(0, 0);
+            m_resolutionMatrix = m_detector->getSpatialResolutionMatrixGlobal(0, 0);
+            auto columns = static_cast<double>(m_detector->nPixels().X() - 1);
+            auto rows = static_cast<double>(m_detector->nPixels().Y() - 1);
+            m_constantResolution = true;
+            for(const auto& point : {std::array<double, 2>{columns, 0},
+                                     std::array<double, 2>{0, rows},
+                                     std::array<double, 2>{columns, rows},
+                                     std::array<double, 2>{columns / 2, rows / 2}}) {
+                m_constantResolution = m_constantResolution &&
+                                       sameResolution(m_detector->getSpatialResolution(point[0], point[1]),
+                                                      m_detector->getSpatialResolutionMatrixGlobal(point[0], point[1]));
+            }
+        }
+
+        bool constantResolution() const { return m_constantResolution; }
+
+        /**
+         * @brief Local position of a strip/pixel position, as Detector::getLocalPosition()
+         */
+        ROOT::Math::XYZPoint getLocalPosition(double column, double row) const {
+            return {m_local[0] + m_local[1] * column + m_local[2] * row, m_local[3] + m_local[4] * column + m_local[5] * row, 0};
+        }
+
+        /**
+         * @brief Global position of a local position, as Detector::localToGlobal()
+         */
+        ROOT::Math::XYZPoint localToGlobal(const ROOT::Math::XYZPoint& local) const {
+            return {m_global[0] + m_global[1] * local.x() + m_global[2] * local.y() + m_global[3] * local.z(),
+                    m_global[4] + m_global[5] * local.x() + m_global[6] * local.y() + m_global[7] * local.z(),
+                    m_global[8] + m_global[9] * local.x() + m_global[10] * local.y() + m_global[11] * local.z()};
+        }
+
+        /**
+         * @brief Global positions of all local positions of an event on the detector plane
+         * @param x Local x positions
+         * @param y Local y positions, as many as x
+         * @param global_x Global x positions, resized to the number of positions
+         * @param global_y Global y positions, resized to the number of positions
+         * @param global_z Global z positions, resized to the number of positions
+         */
+        void localToGlobal(const std::vector<double>& x,
+                           const std::vector<double>& y,
+                           std::vector<double>& global_x,
+                           std::vector<double>& global_y,
+                           std::vector<double>& global_z) const {
+            auto size = x.size();
+            global_x.resize(size);
+            global_y.resize(size);
+            global_z.resize(size);
+
+            const double* in_x = x.data();
+            const double* in_y = y.data();
+            double* out_x = global_x.data();
+            double* out_y = global_y.data();
+            double* out_z = global_z.data();
+            const auto g = m_global;
+            for(size_t i = 0; i < size; i++) {
+                out_x[i] = g[0] + g[1] * in_x[i] + g[2] * in_y[i];
+                out_y[i] = g[4] + g[5] * in_x[i] + g[6] * in_y[i];
+                out_z[i] = g[8] + g[9] * in_x[i] + g[10] * in_y[i];
+            }
+        }
+
+        /**
+         * @brief Spatial resolution at a strip/pixel position, as Detector::getSpatialResolution()
+         */
+        ROOT::Math::XYVector getSpatialResolution(double column, double row) const {
+            return m_constantResolution ? m_resolution : m_detector->getSpatialResolution(column, row);
+        }
+
+        /**
+         * @brief Global resolution matrix at a strip/pixel position, as Detector::getSpatialResolutionMatrixGlobal()
+         */
+        TMatrixD getSpatialResolutionMatrixGlobal(double column, double row) const {
+            return m_constantResolution ? m_resolutionMatrix : m_detector->getSpatialResolutionMatrixGlobal(column, row);
+        }
+
+    private:
+        bool sameResolution(const ROOT::Math::XYVector& resolution, const TMatrixD& matrix) const {
+            if(resolution.x() != m_resolution.x() || resolution.y() != m_resolution.y() ||
+               matrix.GetNrows() != m_resolutionMatrix.GetNrows() || matrix.GetNcols() != m_resolutionMatrix.GetNcols()) {
+                return false;
+            }
+            for(int i = 0; i < matrix.GetNrows(); i++) {
+                for(int j = 0; j < matrix.GetNcols(); j++) {
+                    if(matrix(i, j) != m_resolutionMatrix(i, j)) {
+                        return false;
+                    }
+                }
+            }
+            return true;
+        }
+
+        std::shared_ptr<Detector> m_detector;
+
+        // x and y as offset + column and row coefficients
+        std::array<double, 6> m_local{};
+
+        // Rows of the 3x4 affine matrix, offset first
+        std::array<double, 12> m_global{};
+
+        bool m_constantResolution{false};
+        ROOT::Math::XYVector m_resolution;
+        TMatrixD m_resolutionMatrix;
+    };
+
+} // namespace corryvreckan
+#endif // CORRYVRECKAN_DETECTOR_GEOMETRY_CACHE_H
@@ -0,0 +1,12 @@
+# SPDX-FileCopyrightText: 2017-2022 CERN and the Corryvreckan authors
+# SPDX-License-Identifier: MIT
+
+# Per-hit tracing of the loader event loops, see HotPathTrace.h. The option is declared here once for all modules,
+# which only call CORRYVRECKAN_HOT_PATH_TRACE_TARGET on their library.
+OPTION(CORRYVRECKAN_HOT_PATH_TRACE "Compile the per-hit tracing of the loader event loops" OFF)
+
+FUNCTION(CORRYVRECKAN_HOT_PATH_TRACE_TARGET target)
+    IF(CORRYVRECKAN_HOT_PATH_TRACE)
+        TARGET_COMPILE_DEFINITIONS(${target} PRIVATE CORRYVRECKAN_HOT_PATH_TRACE)
+    ENDIF()
+ENDFUNCTION()
@@ -0,0 +1,92 @@
+/**
+ * @file
+ * @brief Per-hit tracing for the inner loops of the loaders, compiled out unless enabled in the build
+ *
+ * @copyright Copyright (c) 2020 CERN and the Corryvreckan authors.
+ * This software is distributed under the terms of the MIT License, copied verbatim in the file "LICENSE.md".
+ * In applying this license, CERN does not waive the privileges and immunities granted to it by virtue of its status as an
+ * Intergovernmental Organization or submit itself to any jurisdiction.
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef CORRYVRECKAN_HOT_PATH_TRACE_H
+#define CORRYVRECKAN_HOT_PATH_TRACE_H
+
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <string>
+
+#include "core/utils/log.h"
+
+/**
+ * @brief Trace a point in a hot loop with a list of "name", value pairs
+ *
+ * Without the CORRYVRECKAN_HOT_PATH_TRACE build option the macro and its arguments are removed by the preprocessor, so
+ * the loops contain no logging branches or stream setup at all.
+ */
+#ifdef CORRYVRECKAN_HOT_PATH_TRACE
+#define HOT_PATH_TRACE(tracer, point, ...) (tracer).record(point, __VA_ARGS__)
+#else
+#define HOT_PATH_TRACE(tracer, point, ...) ((void)0)
+#endif
+
+namespace corryvreckan {
+    /**
+     * @brief Counts the traced points of a module and logs a sample of the records
+     *
+     * Every call is counted per trace point, and every n-th record of a point is written to the log with all its fields.
+     * The counters are logged at the end of the run.
+     */
+    class HotPathTracer {
+
+    public:
+        explicit HotPathTracer(long sample_interval = 1000) : m_sampleInterval(std::max(sample_interval, 1L)) {}
+
+        template <typename... Fields> void record(const char* point, const Fields&... fields) {
+            auto count = ++m_counters[point];
+            if((count - 1) % m_sampleInterval != 0) {
+                return;
+            }
+
+            std::ostringstream record;
+            record << std::fixed << std::setprecision(15) << point << " #" << count;
+            writeFields(record, fields...);
+            LOG(DEBUG) << record.str();
+        }
+
+        /**
+         * @brief Add the counters of another tracer, e.g. of a worker thread
+         */
+        void merge(const HotPathTracer& other) {
+            for(const auto& counter : other.m_counters) {
+                m_counters[counter.first] += counter.second;
+            }
+        }
+
+        /**
+         * @brief Log the number of records of every trace point
+         * @param name Name of the module instance
+         */
+        void report(const std::string& name) const {
+            for(const auto& counter : m_counters) {
+                LOG(STATUS) << name << " traced " << counter.second << " times " << counter.first;
+            }
+        }
+
+    private:
+        static void writeFields(std::ostringstream&) {}
+
+        template <typename Value, typename... Fields>
+        static void writeFields(std::ostringstream& record, const char* name, const Value& value, const Fields&... fields) {
+            record << " " << name << "=" << +value;
+            writeFields(record, fields...);
+        }
+
+        long m_sampleInterval;
+        std::map<std::string, long> m_counters;
+    };
+
+} // namespace corryvreckan
+#endif // CORRYVRECKAN_HOT_PATH_TRACE_H
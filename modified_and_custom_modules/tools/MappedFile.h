@@ -0,0 +1,154 @@
+/**
+ * @file
+ * @brief Read-only memory mapping of a file for the cache files of the loaders
+ *
+ * @copyright Copyright (c) 2020 CERN and the Corryvreckan authors.
+ * This software is distributed under the terms of the MIT License, copied verbatim in the file "LICENSE.md".
+ * In applying this license, CERN does not waive the privileges and immunities granted to it by virtue of its status as an
+ * Intergovernmental Organization or submit itself to any jurisdiction.
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef CORRYVRECKAN_MAPPED_FILE_H
+#define CORRYVRECKAN_MAPPED_FILE_H
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace corryvreckan {
+    /**
+     * @brief Whole file mapped read-only into memory
+     *
+     * The pages are loaded by the kernel on first access and stay in the page cache between runs, so a file read again
+     * by the next run is read at memory speed without any copy into the process. The mapping is released with the
+     * object.
+     */
+    class MappedFile {
+
+    public:
+        MappedFile() = default;
+        ~MappedFile() { close(); }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        MappedFile(MappedFile&& other) noexcept
+            : m_data(std::exchange(other.m_data, nullptr)), m_size(std::exchange(other.m_size, 0)) {}
+        MappedFile& operator=(MappedFile&& other) noexcept {
+            if(this != &other) {
+                close();
+                m_data = std::exchange(other.m_data, nullptr);
+                m_size = std::exchange(other.m_size, 0);
+            }
+            return *this;
+        }
+
+        /**
+         * @brief Map a file, replacing the current mapping
+         * @param path Path of the file
+         * @param sequential Tell the kernel that the file is read front to back, so it reads ahead
+         * @return False if the file cannot be opened or is empty
+         */
+        bool open(const std::string& path, bool sequential = true) {
+            close();
+
+            auto fd = ::open(path.c_str(), O_RDONLY);
+            if(fd < 0) {
+                return false;
+            }
+
+            struct stat status {};
+            if(::fstat(fd, &status) != 0 || status.st_size <= 0) {
+                ::close(fd);
+                return false;
+            }
+
+            // The mapping keeps its own reference to the file
+            auto size = static_cast<size_t>(status.st_size);
+            auto data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if(data == MAP_FAILED) {
+                return false;
+            }
+
+            if(sequential) {
+                ::madvise(data, size, MADV_SEQUENTIAL);
+            }
+            m_data = static_cast<const uint8_t*>(data);
+            m_size = size;
+            return true;
+        }
+
+        void close() {
+            if(m_data != nullptr) {
+                ::munmap(const_cast<uint8_t*>(m_data), m_size);
+                m_data = nullptr;
+                m_size = 0;
+            }
+        }
+
+        bool valid() const { return m_data != nullptr; }
+        const uint8_t* data() const { return m_data; }
+        size_t size() const { return m_size; }
+
+        /**
+         * @brief Object of type T at a byte offset, the caller checks that it is within the file
+         */
+        template <typename T> const T* at(size_t offset) const { return reinterpret_cast<const T*>(m_data + offset); }
+
+    private:
+        const uint8_t* m_data{nullptr};
+        size_t m_size{0};
+    };
+
+    /**
+     * @brief FNV-1a hash of a block of data, continued from a previous hash
+     */
+    inline uint64_t fnv1a(const void* data, size_t size, uint64_t hash = 14695981039346656037ULL) {
+        auto bytes = static_cast<const uint8_t*>(data);
+        for(size_t i = 0; i < size; i++) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    /**
+     * @brief Fingerprint of an input file for the keys of the caches made from it
+     *
+     * Hashing a whole input file would cost about as much as reading it, so only its size and its first and last MB are
+     * hashed. For ROOT files these hold the file header and the list of keys, which change with any rewrite of the file.
+     * @return Zero if the file cannot be read
+     */
+    inline uint64_t fileFingerprint(const std::string& path) {
+        std::ifstream input(path, std::ios::binary | std::ios::ate);
+        if(!input) {
+            return 0;
+        }
+
+        auto size = static_cast<uint64_t>(input.tellg());
+        auto hash = fnv1a(&size, sizeof(size));
+
+        const uint64_t block = 1024 * 1024;
+        std::vector<char> buffer(static_cast<size_t>(std::min(block, size)));
+        input.seekg(0);
+        input.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        hash = fnv1a(buffer.data(), buffer.size(), hash);
+        input.seekg(static_cast<std::streamoff>(size - buffer.size()));
+        input.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        hash = fnv1a(buffer.data(), buffer.size(), hash);
+        return hash == 0 ? 1 : hash;
+    }
+
+} // namespace corryvreckan
+#endif // CORRYVRECKAN_MAPPED_FILE_H
@@ -0,0 +1,173 @@
+/**
+ * @file
+ * @brief Pooled allocation of the objects created by the loaders
+ *
+ * @copyright Copyright (c) 2020 CERN and the Corryvreckan authors.
+ * This software is distributed under the terms of the MIT License, copied verbatim in the file "LICENSE.md".
+ * In applying this license, CERN does not waive the privileges and immunities granted to it by virtue of its status as an
+ * Intergovernmental Organization or submit itself to any jurisdiction.
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef CORRYVRECKAN_OBJECT_POOL_H
+#define CORRYVRECKAN_OBJECT_POOL_H
+
+#include <algorithm>
+#include <cstddef>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "core/utils/log.h"
+
+namespace corryvreckan {
+    /**
+     * @brief Free list of equally sized memory blocks, taken from the heap in chunks of many blocks
+     *
+     * The block size is fixed by the first allocation. Blocks given back are put on the free list and handed out again,
+     * so after the first events the pool serves all allocations without going to the heap.
+     */
+    class ObjectPool {
+
+    public:
+        explicit ObjectPool(size_t chunk_blocks = 4096) : m_chunkBlocks(chunk_blocks) {}
+
+        ObjectPool(const ObjectPool&) = delete;
+        ObjectPool& operator=(const ObjectPool&) = delete;
+
+        /**
+         * @brief Check if an allocation of the given size is served by the pool
+         */
+        bool fits(size_t bytes) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if(m_blockSize == 0) {
+                auto align = alignof(std::max_align_t);
+                m_blockSize = (std::max(bytes, sizeof(void*)) + align - 1) / align * align;
+            }
+            return bytes <= m_blockSize;
+        }
+
+        void* allocate() {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if(m_free == nullptr) {
+                grow();
+            }
+            auto block = m_free;
+            m_free = *static_cast<void**>(block);
+            return block;
+        }
+
+        void deallocate(void* block) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            *static_cast<void**>(block) = m_free;
+            m_free = block;
+        }
+
+        // Number of heap allocations done by the pool
+        size_t getChunkCount() const { return m_chunks.size(); }
+
+    private:
+        void grow() {
+            m_chunks.emplace_back(new unsigned char[m_blockSize * m_chunkBlocks]);
+            auto chunk = m_chunks.back().get();
+            for(size_t i = m_chunkBlocks; i-- > 0;) {
+                auto block = chunk + i * m_blockSize;
+                *reinterpret_cast<void**>(block) = m_free;
+                m_free = block;
+            }
+        }
+
+        size_t m_chunkBlocks;
+        size_t m_blockSize{0};
+        void* m_free{nullptr};
+        std::vector<std::unique_ptr<unsigned char[]>> m_chunks;
+        std::mutex m_mutex;
+    };
+
+    /**
+     * @brief Allocator taking single objects from an ObjectPool, used with std::allocate_shared
+     *
+     * Every allocator holds a reference to the pool, so the pool lives as long as the last object allocated from it,
+     * also if that object is still on the clipboard when the module is destroyed.
+     */
+    template <typename T> class PoolAllocator {
+
+    public:
+        using value_type = T;
+
+        explicit PoolAllocator(std::shared_ptr<ObjectPool> pool) noexcept : m_pool(std::move(pool)) {}
+        template <typename U> PoolAllocator(const PoolAllocator<U>& other) noexcept : m_pool(other.m_pool) {}
+
+        T* allocate(size_t n) {
+            if(n == 1 && m_pool->fits(sizeof(T))) {
+                return static_cast<T*>(m_pool->allocate());
+            }
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        }
+
+        void deallocate(T* p, size_t n) noexcept {
+            if(n == 1 && m_pool->fits(sizeof(T))) {
+                m_pool->deallocate(p);
+            } else {
+                ::operator delete(p);
+            }
+        }
+
+        template <typename U> bool operator==(const PoolAllocator<U>& other) const { return m_pool == other.m_pool; }
+        template <typename U> bool operator!=(const PoolAllocator<U>& other) const { return m_pool != other.m_pool; }
+
+    private:
+        template <typename U> friend class PoolAllocator;
+        std::shared_ptr<ObjectPool> m_pool;
+    };
+
+    /**
+     * @brief Creates the objects of a loader either with std::make_shared or from a pool, and counts the allocations
+     *
+     * The objects end up on the clipboard and are released when it is cleared at the end of the event, which puts their
+     * memory back on the free list of the pool for the next event.
+     */
+    template <typename T> class ObjectFactory {
+
+    public:
+        explicit ObjectFactory(bool pooled = false) {
+            if(pooled) {
+                m_pool = std::make_shared<ObjectPool>();
+            }
+        }
+
+        template <typename... Args> std::shared_ptr<T> make(Args&&... args) {
+            m_objects++;
+            if(m_pool) {
+                return std::allocate_shared<T>(PoolAllocator<T>(m_pool), std::forward<Args>(args)...);
+            }
+            return std::make_shared<T>(std::forward<Args>(args)...);
+        }
+
+        /**
+         * @brief Log the number of created objects and of heap allocations per event
+         * @param name Name of the module instance
+         * @param events Number of processed events
+         */
+        void report(const std::string& name, long events) const {
+            // Without the pool every object is one heap allocation of object and control block
+            auto allocations = (m_pool ? m_pool->getChunkCount() : m_objects);
+            auto per_event = [events](size_t count) {
+                return static_cast<double>(count) / static_cast<double>(std::max(events, 1L));
+            };
+            LOG(STATUS) << name << " created " << m_objects << " objects (" << std::fixed << std::setprecision(2)
+                        << per_event(m_objects) << " per event) with " << allocations << " heap allocations ("
+                        << per_event(allocations) << " per event)" << (m_pool ? " from the object pool" : "");
+        }
+
+    private:
+        std::shared_ptr<ObjectPool> m_pool;
+        size_t m_objects{0};
+    };
+
+} // namespace corryvreckan
+#endif // CORRYVRECKAN_OBJECT_POOL_H
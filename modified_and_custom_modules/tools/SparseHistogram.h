@@ -0,0 +1,164 @@
+/**
+ * @file
+ * @brief Sparse, auto-ranging histogram for wide axes such as the time of a whole run
+ *
+ * @copyright Copyright (c) 2020 CERN and the Corryvreckan authors.
+ * This software is distributed under the terms of the MIT License, copied verbatim in the file "LICENSE.md".
+ * In applying this license, CERN does not waive the privileges and immunities granted to it by virtue of its status as an
+ * Intergovernmental Organization or submit itself to any jurisdiction.
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef CORRYVRECKAN_SPARSE_HISTOGRAM_H
+#define CORRYVRECKAN_SPARSE_HISTOGRAM_H
+
+#include <TH1F.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace corryvreckan {
+    /**
+     * @brief One dimensional histogram that only stores its filled bins
+     *
+     * No bins are allocated when the histogram is booked. The first entries are buffered, and their range divided into
+     * the requested number of bins gives the bin width and origin. From then on only the bins that are filled take
+     * memory, and entries outside the first range simply fill new bins. Once more bins are filled than requested, the
+     * bin width is doubled and neighbouring pairs of bins are merged, so the memory stays bounded by the requested number
+     * of bins however wide the filled range gets. The histogram is turned into a TH1F covering all filled bins when it is
+     * written; if they span more than the requested number of bins, neighbouring bins are merged there as well.
+     */
+    class SparseHistogram {
+
+    public:
+        SparseHistogram() = default;
+
+        /**
+         * @brief Constructor
+         * @param name Name of the TH1F made by toTH1F()
+         * @param title Title and axis titles of the TH1F
+         * @param bins Number of bins over the range of the first entries, also the largest number of stored bins and of bins
+         * of the TH1F, at least two
+         * @param range_entries Number of entries that set the range
+         */
+        SparseHistogram(std::string name, std::string title, int bins, size_t range_entries = 1000)
+            : m_name(std::move(name)), m_title(std::move(title)), m_bins(std::max(bins, 2)),
+              m_rangeEntries(std::max<size_t>(range_entries, 1)) {}
+
+        void Fill(double x) {
+            if(!std::isfinite(x)) {
+                return;
+            }
+            m_entries++;
+            if(m_width > 0) {
+                add(x);
+                return;
+            }
+
+            m_buffer.push_back(x);
+            if(m_buffer.size() >= m_rangeEntries) {
+                setRange();
+            }
+        }
+
+        size_t entries() const { return m_entries; }
+
+        /**
+         * @brief Histogram of all entries as a TH1F, created in and owned by the current ROOT directory
+         */
+        TH1F* toTH1F() {
+            if(m_width <= 0) {
+                setRange();
+            }
+            if(m_counts.empty()) {
+                return new TH1F(m_name.c_str(), m_title.c_str(), m_bins, 0, 1);
+            }
+
+            int64_t first = m_counts.begin()->first;
+            int64_t last = first;
+            for(const auto& count : m_counts) {
+                first = std::min(first, count.first);
+                last = std::max(last, count.first);
+            }
+
+            // Merge neighbouring bins if the filled ones span more than the booked number of bins
+            auto span = last - first + 1;
+            auto merge = (span + m_bins - 1) / m_bins;
+            auto bins = static_cast<int>((span + merge - 1) / merge);
+            auto low = m_origin + static_cast<double>(first) * m_width;
+            auto histogram = new TH1F(m_name.c_str(), m_title.c_str(), bins, low, low + static_cast<double>(bins * merge) * m_width);
+            for(const auto& count : m_counts) {
+                auto target = static_cast<int>((count.first - first) / merge) + 1;
+                histogram->AddBinContent(target, count.second);
+            }
+            histogram->SetEntries(static_cast<double>(m_entries));
+            return histogram;
+        }
+
+    private:
+        int64_t bin(double x) const { return static_cast<int64_t>(std::floor((x - m_origin) / m_width)); }
+
+        // Far outliers widen the bins until their index fits, the bins stay at most m_bins
+        void add(double x) {
+            while(std::fabs((x - m_origin) / m_width) >= max_index) {
+                merge();
+            }
+            m_counts[bin(x)]++;
+            while(m_counts.size() > static_cast<size_t>(m_bins)) {
+                merge();
+            }
+        }
+
+        // Doubles the bin width, bin k goes into bin floor(k / 2) with the same origin
+        void merge() {
+            std::unordered_map<int64_t, double> merged;
+            merged.reserve(m_counts.size() / 2 + 1);
+            for(const auto& count : m_counts) {
+                auto index = count.first >= 0 ? count.first / 2 : (count.first - 1) / 2;
+                merged[index] += count.second;
+            }
+            m_counts.swap(merged);
+            m_width *= 2;
+        }
+
+        static constexpr double max_index = 4e18;
+
+        // The range of the buffered entries sets the bins, a buffer without spread gets bins of width one around it
+        void setRange() {
+            if(m_buffer.empty()) {
+                m_origin = 0;
+                m_width = 1;
+                return;
+            }
+
+            auto range = std::minmax_element(m_buffer.begin(), m_buffer.end());
+            auto spread = *range.second - *range.first;
+            m_width = spread > 0 ? spread / m_bins : 1;
+            m_origin = spread > 0 ? *range.first : *range.first - 0.5 * m_bins;
+
+            for(auto x : m_buffer) {
+                add(x);
+            }
+            m_buffer.clear();
+            m_buffer.shrink_to_fit();
+        }
+
+        std::string m_name;
+        std::string m_title;
+        int m_bins{100};
+        size_t m_rangeEntries{1000};
+
+        size_t m_entries{0};
+        std::vector<double> m_buffer;
+        double m_origin{0};
+        double m_width{0};
+        std::unordered_map<int64_t, double> m_counts;
+    };
+
+} // namespace corryvreckan
+#endif // CORRYVRECKAN_SPARSE_HISTOGRAM_H
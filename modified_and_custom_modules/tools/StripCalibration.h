@@ -0,0 +1,190 @@
+/**
+ * @file
+ * @brief Per-plane calibration of the strip positions of the loaders
+ *
+ * @copyright Copyright (c) 2020 CERN and the Corryvreckan authors.
+ * This software is distributed under the terms of the MIT License, copied verbatim in the file "LICENSE.md".
+ * In applying this license, CERN does not waive the privileges and immunities granted to it by virtue of its status as an
+ * Intergovernmental Organization or submit itself to any jurisdiction.
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef CORRYVRECKAN_STRIP_CALIBRATION_H
+#define CORRYVRECKAN_STRIP_CALIBRATION_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "core/config/Configuration.hpp"
+#include "core/config/exceptions.h"
+#include "core/module/exceptions.h"
+#include "core/utils/log.h"
+
+namespace corryvreckan {
+    /**
+     * @brief Conversion of measured strip positions into calibrated strip positions, for the X (0) and Y (1) plane
+     *
+     * The calibrated position of a strip position p is scale * p + offset + correction(p), in units of the strips of the
+     * detector geometry, which then applies the pitch and the alignment. The scale and offset of each plane are read
+     * from the `strip_scale` and `strip_offset` keys of the module configuration. The file given by
+     * `strip_calibration_file` holds the per-strip corrections and dead strips, one strip per line as
+     * `plane strip correction [dead]`, with `#` starting a comment. The correction is linearly interpolated between
+     * neighbouring strips, and a position is dropped if its closest strip is dead.
+     *
+     * Everything is tabulated in initialize(), apply() then converts all positions of an event with the same
+     * arithmetic for every position and no branches on the calibration.
+     */
+    class StripCalibration {
+
+    public:
+        StripCalibration() = default;
+
+        /**
+         * @brief Read the calibration from the module configuration
+         * @param config Configuration of the module
+         * @param strips_x Number of strips of the X plane
+         * @param strips_y Number of strips of the Y plane
+         */
+        StripCalibration(const Configuration& config, int strips_x, int strips_y) {
+            m_enabled = config.has("strip_scale") || config.has("strip_offset") || config.has("strip_calibration_file");
+
+            auto scale = config.getArray<double>("strip_scale", {1, 1});
+            auto offset = config.getArray<double>("strip_offset", {0, 0});
+            if(scale.size() != 2) {
+                throw InvalidValueError(config, "strip_scale", "needs one value for the X and one for the Y plane");
+            }
+            if(offset.size() != 2) {
+                throw InvalidValueError(config, "strip_offset", "needs one value for the X and one for the Y plane");
+            }
+
+            std::array<int, 2> strips{strips_x, strips_y};
+            for(size_t plane = 0; plane < 2; plane++) {
+                auto& table = m_planes[plane];
+                table.scale = scale[plane];
+                table.offset = offset[plane];
+                table.strips = static_cast<size_t>(std::max(strips[plane], 1));
+                // One padding entry so the interpolation at the last strip needs no check
+                table.correction.assign(table.strips + 1, 0);
+                table.dead.assign(table.strips, 0);
+            }
+
+            if(config.has("strip_calibration_file")) {
+                readFile(config, config.getPath("strip_calibration_file", true));
+            }
+        }
+
+        // Only if any of the calibration keys is given, otherwise the positions are used as they are
+        bool enabled() const { return m_enabled; }
+
+        /**
+         * @brief Reject the calibration keys of a module configuration in which the calibration is not used
+         * @param config Configuration of the module
+         * @param reason Why the calibration is not used, for the error message
+         */
+        static void reject(const Configuration& config, const std::string& reason) {
+            for(const auto& key : {"strip_scale", "strip_offset", "strip_calibration_file"}) {
+                if(config.has(key)) {
+                    throw InvalidValueError(config, key, reason);
+                }
+            }
+        }
+
+        /**
+         * @brief Calibrate all strip positions of an event on one plane
+         * @param plane Plane ID, 0 for X and 1 for Y strips
+         * @param positions Measured strip positions
+         * @param calibrated Calibrated strip positions, resized to the number of positions
+         * @param alive Zero for positions on a dead strip, resized to the number of positions
+         */
+        void apply(int plane,
+                   const std::vector<double>& positions,
+                   std::vector<double>& calibrated,
+                   std::vector<unsigned char>& alive) const {
+            const auto& table = m_planes[static_cast<size_t>(plane)];
+            auto size = positions.size();
+            calibrated.resize(size);
+            alive.resize(size);
+
+            const double* in = positions.data();
+            double* out = calibrated.data();
+            unsigned char* out_alive = alive.data();
+            const double* correction = table.correction.data();
+            const unsigned char* dead = table.dead.data();
+            const auto last = static_cast<double>(table.strips - 1);
+            for(size_t i = 0; i < size; i++) {
+                // Positions outside the plane take the correction of the closest strip
+                auto strip = in[i] > 0 ? std::min(in[i], last) : 0.0;
+                auto index = static_cast<size_t>(strip);
+                auto fraction = strip - static_cast<double>(index);
+                auto shift = correction[index] + (correction[index + 1] - correction[index]) * fraction;
+                out[i] = table.scale * in[i] + table.offset + shift;
+                out_alive[i] = static_cast<unsigned char>(dead[static_cast<size_t>(strip + 0.5)] == 0);
+            }
+        }
+
+    private:
+        struct Plane {
+            double scale{1};
+            double offset{0};
+            size_t strips{1};
+            std::vector<double> correction;
+            std::vector<unsigned char> dead;
+        };
+
+        void readFile(const Configuration& config, const std::string& path) {
+            std::ifstream file(path);
+            if(!file) {
+                throw InvalidValueError(config, "strip_calibration_file", "cannot open " + path);
+            }
+
+            std::string line;
+            size_t line_number = 0;
+            size_t entries = 0;
+            while(std::getline(file, line)) {
+                line_number++;
+                line = line.substr(0, line.find('#'));
+                if(line.find_first_not_of(" \t\r") == std::string::npos) {
+                    continue;
+                }
+
+                std::stringstream stream(line);
+                int plane = -1;
+                long strip = -1;
+                double correction = 0;
+                int dead = 0;
+                if(!(stream >> plane >> strip >> correction)) {
+                    throw InvalidValueError(config,
+                                            "strip_calibration_file",
+                                            path + ":" + std::to_string(line_number) + " is not of the form plane strip correction [dead]");
+                }
+                stream >> dead;
+                if(plane < 0 || plane > 1 || strip < 0 || static_cast<size_t>(strip) >= m_planes[static_cast<size_t>(plane)].strips) {
+                    throw InvalidValueError(config,
+                                            "strip_calibration_file",
+                                            path + ":" + std::to_string(line_number) + " has a plane or strip outside the detector");
+                }
+
+                auto& table = m_planes[static_cast<size_t>(plane)];
+                table.correction[static_cast<size_t>(strip)] = correction;
+                table.dead[static_cast<size_t>(strip)] = static_cast<unsigned char>(dead != 0);
+                entries++;
+            }
+
+            // The padding entry repeats the last strip
+            for(auto& table : m_planes) {
+                table.correction[table.strips] = table.correction[table.strips - 1];
+            }
+            LOG(DEBUG) << "Read the calibration of " << entries << " strips from " << path;
+        }
+
+        bool m_enabled{false};
+        std::array<Plane, 2> m_planes;
+    };
+
+} // namespace corryvreckan
+#endif // CORRYVRECKAN_STRIP_CALIBRATION_H
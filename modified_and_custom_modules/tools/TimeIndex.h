@@ -0,0 +1,138 @@
+/**
+ * @file
+ * @brief Block index over a time ordered TTree branch
+ *
+ * @copyright Copyright (c) 2020 CERN and the Corryvreckan authors.
+ * This software is distributed under the terms of the MIT License, copied verbatim in the file "LICENSE.md".
+ * In applying this license, CERN does not waive the privileges and immunities granted to it by virtue of its status as an
+ * Intergovernmental Organization or submit itself to any jurisdiction.
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef CORRYVRECKAN_TIME_INDEX_H
+#define CORRYVRECKAN_TIME_INDEX_H
+
+#include <TTree.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "core/utils/log.h"
+#include "tools/BulkBranchReader.h"
+
+namespace corryvreckan {
+    /**
+     * @brief Index of the time branch of the vmm-sdat trees, used to find the end of an event window
+     *
+     * The time column is read once when the index is built, and for every block of entries the time of the first entry
+     * is stored. The end of an event window is then found with a binary search over the block table followed by a binary
+     * search inside a single block, instead of stepping through the entries one by one. If the branch turns out not to
+     * be sorted in time, the search falls back to a linear scan which stops at the first entry outside the window.
+     */
+    class TimeIndex {
+
+    public:
+        TimeIndex() = default;
+
+        /**
+         * @brief Build the index by reading the whole time branch once
+         * @param tree Tree containing the time branch
+         * @param branch Name of the time branch, e.g. time or time0
+         * @param block_size Number of entries per block of the index
+         */
+        TimeIndex(TTree* tree, const std::string& branch, Long64_t block_size = 16384)
+            : m_reader(tree, branch), m_blockSize(block_size), m_entries(m_reader.getEntries()) {
+
+            double last_time = 0;
+            for(Long64_t first = 0; first < m_entries; first += m_blockSize) {
+                m_times.clear();
+                m_reader.read(first, first + m_blockSize, m_times);
+
+                m_blockFirst.push_back(m_times.front());
+                if(first > 0 && m_times.front() < last_time) {
+                    m_sorted = false;
+                }
+                if(!std::is_sorted(m_times.begin(), m_times.end())) {
+                    m_sorted = false;
+                }
+                last_time = m_times.back();
+            }
+            m_loadedBlock = static_cast<Long64_t>(m_blockFirst.size()) - 1;
+
+            LOG(DEBUG) << "Indexed " << m_entries << " entries of branch " << branch << " in " << m_blockFirst.size()
+                       << " blocks, sorted in time: " << std::boolalpha << m_sorted;
+        }
+
+        /**
+         * @brief Find the first entry from begin on which is outside an event window
+         * @param begin First entry of the window
+         * @param reference Time the window is counted from
+         * @param duration Length of the window, an entry is outside if time - reference > duration
+         * @return Entry number, or the number of entries if the window reaches the end of the tree
+         */
+        Long64_t findWindowEnd(Long64_t begin, double reference, double duration) {
+            auto inside = [reference, duration](double t) { return !(t - reference > duration); };
+
+            if(!m_sorted) {
+                for(auto block = begin / m_blockSize; block < static_cast<Long64_t>(m_blockFirst.size()); block++) {
+                    loadBlock(block);
+                    auto from = m_times.begin() + (std::max(begin, block * m_blockSize) - block * m_blockSize);
+                    auto it = std::find_if_not(from, m_times.end(), inside);
+                    if(it != m_times.end()) {
+                        return block * m_blockSize + (it - m_times.begin());
+                    }
+                }
+                return m_entries;
+            }
+
+            // Last block starting inside the window, the window ends in this block or right after it
+            auto first_block = m_blockFirst.begin() + begin / m_blockSize;
+            auto block = std::partition_point(first_block + 1, m_blockFirst.end(), inside) - m_blockFirst.begin() - 1;
+
+            loadBlock(block);
+            auto from = m_times.begin() + (std::max(begin, block * m_blockSize) - block * m_blockSize);
+            auto it = std::partition_point(from, m_times.end(), inside);
+            return block * m_blockSize + (it - m_times.begin());
+        }
+
+        /**
+         * @brief Time of a single entry
+         */
+        double getTime(Long64_t entry) {
+            loadBlock(entry / m_blockSize);
+            return m_times[static_cast<size_t>(entry % m_blockSize)];
+        }
+
+        /**
+         * @brief Append the times of the entries [first, last) to a column, sharing the decoded baskets of the index
+         */
+        void read(Long64_t first, Long64_t last, std::vector<double>& column) { m_reader.read(first, last, column); }
+
+        bool isSorted() const { return m_sorted; }
+
+    private:
+        void loadBlock(Long64_t block) {
+            if(block == m_loadedBlock) {
+                return;
+            }
+            m_times.clear();
+            m_reader.read(block * m_blockSize, (block + 1) * m_blockSize, m_times);
+            m_loadedBlock = block;
+        }
+
+        BulkBranchReader<double> m_reader;
+        Long64_t m_blockSize{16384};
+        Long64_t m_entries{0};
+        bool m_sorted{true};
+
+        // Time of the first entry of every block
+        std::vector<double> m_blockFirst;
+
+        // Times of the last block that was searched
+        std::vector<double> m_times;
+        Long64_t m_loadedBlock{-1};
+    };
+
+} // namespace corryvreckan
+#endif // CORRYVRECKAN_TIME_INDEX_H
@@ -0,0 +1,440 @@
+/**
+ * @file
+ * @brief Memory-mapped columnar copy of the vmm-sdat clusters_detector tree
+ *
+ * @copyright Copyright (c) 2020 CERN and the Corryvreckan authors.
+ * This software is distributed under the terms of the MIT License, copied verbatim in the file "LICENSE.md".
+ * In applying this license, CERN does not waive the privileges and immunities granted to it by virtue of its status as an
+ * Intergovernmental Organization or submit itself to any jurisdiction.
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef CORRYVRECKAN_VMM3A_COLUMN_CACHE_H
+#define CORRYVRECKAN_VMM3A_COLUMN_CACHE_H
+
+#include <TFile.h>
+#include <TTreeReader.h>
+#include <TTreeReaderArray.h>
+#include <TTreeReaderValue.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "core/module/exceptions.h"
+#include "core/utils/log.h"
+#include "tools/MappedFile.h"
+
+namespace corryvreckan {
+    /**
+     * @brief Clusters of a clusters_detector tree in a flat file, sorted in time0 and read through a memory mapping
+     *
+     * The tree is converted once, see convert(): every used branch becomes one contiguous column, and the strips and adcs arrays of all
+     * clusters are stored one after the other in a blob per plane, with the offset of the first strip of every cluster.
+     * The entries are sorted in time0, so event windows and track time windows are found with a binary search. Later
+     * runs map the file and read the columns in place, without any ROOT decoding or copy.
+     *
+     * The file has a format version and the fingerprint of the tree file. A cache with another version or of another
+     * input file is converted again.
+     */
+    class VMM3aColumnCache {
+
+    public:
+        static constexpr uint32_t version = 1;
+
+        // Strips and their ADC values of one plane of a cluster
+        struct Strips {
+            const double* strips;
+            const double* adcs;
+            size_t size;
+        };
+
+        /**
+         * @brief Map the cache of an input file, converting the clusters_detector tree first if there is no valid cache
+         * @param input_file ROOT file with the clusters_detector tree
+         * @param path Path of the cache file
+         */
+        void open(const std::string& input_file, const std::string& path) {
+            auto key = fileFingerprint(input_file);
+            if(key == 0) {
+                throw ModuleError("Cannot read the input file " + input_file);
+            }
+            if(map(path, key)) {
+                LOG(INFO) << "Mapped " << m_entries << " clusters from the column cache " << path;
+                return;
+            }
+
+            LOG(INFO) << "No valid column cache at " << path << ", converting the clusters_detector tree of " << input_file;
+            convert(input_file, path, key);
+            if(!map(path, key)) {
+                throw ModuleError("Cannot read the column cache " + path + " just written");
+            }
+            LOG(INFO) << "Converted " << m_entries << " clusters into " << path;
+        }
+
+        size_t size() const { return m_entries; }
+
+        unsigned char det(size_t entry) const { return m_det[entry]; }
+        double time0(size_t entry) const { return m_time0[entry]; }
+        double pos0(size_t entry, bool charge2 = false) const { return charge2 ? m_pos0Charge2[entry] : m_pos0[entry]; }
+        double pos1(size_t entry, bool charge2 = false) const { return charge2 ? m_pos1Charge2[entry] : m_pos1[entry]; }
+        uint16_t adc0(size_t entry) const { return m_adc0[entry]; }
+        uint16_t adc1(size_t entry) const { return m_adc1[entry]; }
+        uint16_t size0(size_t entry) const { return m_size0[entry]; }
+        uint16_t size1(size_t entry) const { return m_size1[entry]; }
+
+        Strips strips0(size_t entry) const {
+            return {m_strips0 + m_index0[entry], m_adcs0 + m_index0[entry], m_index0[entry + 1] - m_index0[entry]};
+        }
+        Strips strips1(size_t entry) const {
+            return {m_strips1 + m_index1[entry], m_adcs1 + m_index1[entry], m_index1[entry + 1] - m_index1[entry]};
+        }
+
+        /**
+         * @brief First entry from begin on with time0 - reference > duration, or size() if there is none
+         */
+        size_t findWindowEnd(size_t begin, double reference, double duration) const {
+            return static_cast<size_t>(std::partition_point(m_time0 + begin,
+                                                            m_time0 + m_entries,
+                                                            [reference, duration](double t) { return !(t - reference > duration); }) -
+                                       m_time0);
+        }
+
+        /**
+         * @brief First entry with time0 > time, or size() if there is none
+         */
+        size_t findAfter(double time) const {
+            return static_cast<size_t>(std::upper_bound(m_time0, m_time0 + m_entries, time) - m_time0);
+        }
+
+    private:
+        enum Column {
+            DET,
+            TIME0,
+            POS0,
+            POS1,
+            POS0_CHARGE2,
+            POS1_CHARGE2,
+            ADC0,
+            ADC1,
+            SIZE0,
+            SIZE1,
+            INDEX0,
+            STRIPS0,
+            ADCS0,
+            INDEX1,
+            STRIPS1,
+            ADCS1,
+            COLUMNS
+        };
+
+        struct Header {
+            char magic[8];
+            uint32_t version;
+            uint32_t columns;
+            uint64_t key;
+            uint64_t entries;
+            uint64_t offsets[COLUMNS];
+            uint64_t sizes[COLUMNS];
+        };
+
+        static constexpr char cache_magic[8] = {'V', 'M', 'M', '3', 'A', 'C', 'O', 'L'};
+
+        bool map(const std::string& path, uint64_t key) {
+            if(!m_file.open(path) || m_file.size() < sizeof(Header)) {
+                m_file.close();
+                return false;
+            }
+
+            auto header = m_file.at<Header>(0);
+            auto valid = std::memcmp(header->magic, cache_magic, sizeof(cache_magic)) == 0 && header->version == version &&
+                         header->columns == COLUMNS && header->key == key;
+            for(size_t column = 0; valid && column < COLUMNS; column++) {
+                valid = header->offsets[column] >= sizeof(Header) && header->offsets[column] <= m_file.size() &&
+                        header->sizes[column] <= m_file.size() - header->offsets[column];
+            }
+            if(!valid) {
+                m_file.close();
+                return false;
+            }
+
+            auto n = header->entries;
+            auto column = [&](Column c) { return header->offsets[c]; };
+            m_entries = static_cast<size_t>(n);
+            m_det = m_file.at<unsigned char>(column(DET));
+            m_time0 = m_file.at<double>(column(TIME0));
+            m_pos0 = m_file.at<double>(column(POS0));
+            m_pos1 = m_file.at<double>(column(POS1));
+            m_pos0Charge2 = m_file.at<double>(column(POS0_CHARGE2));
+            m_pos1Charge2 = m_file.at<double>(column(POS1_CHARGE2));
+            m_adc0 = m_file.at<uint16_t>(column(ADC0));
+            m_adc1 = m_file.at<uint16_t>(column(ADC1));
+            m_size0 = m_file.at<uint16_t>(column(SIZE0));
+            m_size1 = m_file.at<uint16_t>(column(SIZE1));
+            m_index0 = m_file.at<uint64_t>(column(INDEX0));
+            m_strips0 = m_file.at<double>(column(STRIPS0));
+            m_adcs0 = m_file.at<double>(column(ADCS0));
+            m_index1 = m_file.at<uint64_t>(column(INDEX1));
+            m_strips1 = m_file.at<double>(column(STRIPS1));
+            m_adcs1 = m_file.at<double>(column(ADCS1));
+
+            // One value per cluster in the plain columns, the strip blobs hold what the last index entry points to
+            const uint64_t value_sizes[] = {sizeof(unsigned char), sizeof(double), sizeof(double), sizeof(double), sizeof(double),
+                                            sizeof(double), sizeof(uint16_t), sizeof(uint16_t), sizeof(uint16_t), sizeof(uint16_t)};
+            for(size_t c = DET; c <= SIZE1; c++) {
+                valid = valid && header->sizes[c] == n * value_sizes[c];
+            }
+            valid = valid && header->sizes[INDEX0] == (n + 1) * sizeof(uint64_t) && header->sizes[INDEX1] == (n + 1) * sizeof(uint64_t) &&
+                    header->sizes[STRIPS0] == m_index0[n] * sizeof(double) && header->sizes[ADCS0] == header->sizes[STRIPS0] &&
+                    header->sizes[STRIPS1] == m_index1[n] * sizeof(double) && header->sizes[ADCS1] == header->sizes[STRIPS1];
+            if(!valid) {
+                m_file.close();
+                m_entries = 0;
+            }
+            return valid;
+        }
+
+        // Writable mapping of the cache being converted, the dirty pages are written back to the file by the kernel
+        class OutputMapping {
+
+        public:
+            OutputMapping(const std::string& path, uint64_t size) : m_path(path), m_size(static_cast<size_t>(size)) {
+                auto fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+                if(fd < 0) {
+                    throw ModuleError("Cannot write the column cache " + path);
+                }
+                void* data = MAP_FAILED;
+                if(::ftruncate(fd, static_cast<off_t>(size)) == 0) {
+                    data = ::mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                }
+                ::close(fd);
+                if(data == MAP_FAILED) {
+                    std::remove(path.c_str());
+                    throw ModuleError("Cannot write the column cache " + path);
+                }
+                m_data = static_cast<uint8_t*>(data);
+            }
+            ~OutputMapping() {
+                release();
+                std::remove(m_path.c_str());
+            }
+
+            OutputMapping(const OutputMapping&) = delete;
+            OutputMapping& operator=(const OutputMapping&) = delete;
+
+            template <typename T> T* at(uint64_t offset) { return reinterpret_cast<T*>(m_data + offset); }
+
+            /**
+             * @brief Flush the file and move it to its final path
+             * @return False if writing failed, the file is removed then
+             */
+            bool commit(const std::string& path) {
+                auto flushed = ::msync(m_data, m_size, MS_SYNC) == 0;
+                release();
+                return flushed && std::rename(m_path.c_str(), path.c_str()) == 0;
+            }
+
+        private:
+            void release() {
+                if(m_data != nullptr) {
+                    ::munmap(m_data, m_size);
+                    m_data = nullptr;
+                }
+            }
+
+            std::string m_path;
+            size_t m_size;
+            uint8_t* m_data{nullptr};
+        };
+
+        /**
+         * @brief Convert the clusters_detector tree into a cache file sorted in time0
+         *
+         * The tree is read twice. The first pass reads only time0 and the number of strips of every cluster, which gives
+         * the time order and with it the place of every value in the file. The file is then sized and mapped for
+         * writing, and the second pass reads all branches in the order of the tree and stores every cluster straight at
+         * its sorted place in all columns. The columns are never held in memory: the peak memory of the process is about
+         * 32 bytes per cluster (time0, the strip counts and the time order in the first pass, or the sorted place of every
+         * cluster in the second), independent of the number of strips. The written pages belong to the page cache and
+         * are written back to disk by the kernel as needed.
+         */
+        static void convert(const std::string& input_file, const std::string& path, uint64_t key) {
+            auto file = std::unique_ptr<TFile>(TFile::Open(input_file.c_str()));
+            if(!file || file->IsZombie()) {
+                throw ModuleError("Error in opening TFile " + input_file);
+            }
+            if(file->Get("clusters_detector") == nullptr) {
+                throw ModuleError("Failed to retrieve TTree 'clusters_detector' from " + input_file);
+            }
+
+            // First pass, only the branches of the time order and the sizes of the strip blobs are read
+            std::vector<double> times;
+            std::vector<uint32_t> counts0, counts1;
+            {
+                TTreeReader reader("clusters_detector", file.get());
+                TTreeReaderValue<double> time0(reader, "time0");
+                TTreeReaderArray<double> strips0(reader, "strips0");
+                TTreeReaderArray<double> strips1(reader, "strips1");
+                while(reader.Next()) {
+                    times.push_back(*time0);
+                    counts0.push_back(static_cast<uint32_t>(strips0.GetSize()));
+                    counts1.push_back(static_cast<uint32_t>(strips1.GetSize()));
+                }
+            }
+            auto entries = times.size();
+
+            // Time order, clusters with the same time0 keep the order of the tree
+            std::vector<uint64_t> order(entries);
+            std::iota(order.begin(), order.end(), 0);
+            std::stable_sort(order.begin(), order.end(), [&](uint64_t a, uint64_t b) { return times[a] < times[b]; });
+
+            // Layout of the file, every column starts on a cache line
+            uint64_t strips_total0 = 0;
+            uint64_t strips_total1 = 0;
+            for(size_t i = 0; i < entries; i++) {
+                strips_total0 += counts0[i];
+                strips_total1 += counts1[i];
+            }
+            Header header{};
+            std::memcpy(header.magic, cache_magic, sizeof(cache_magic));
+            header.version = version;
+            header.columns = COLUMNS;
+            header.key = key;
+            header.entries = entries;
+            const uint64_t value_sizes[] = {sizeof(unsigned char), sizeof(double), sizeof(double), sizeof(double), sizeof(double),
+                                            sizeof(double), sizeof(uint16_t), sizeof(uint16_t), sizeof(uint16_t), sizeof(uint16_t)};
+            for(size_t c = DET; c <= SIZE1; c++) {
+                header.sizes[c] = entries * value_sizes[c];
+            }
+            header.sizes[INDEX0] = header.sizes[INDEX1] = (entries + 1) * sizeof(uint64_t);
+            header.sizes[STRIPS0] = header.sizes[ADCS0] = strips_total0 * sizeof(double);
+            header.sizes[STRIPS1] = header.sizes[ADCS1] = strips_total1 * sizeof(double);
+            uint64_t file_size = sizeof(Header);
+            for(size_t c = 0; c < COLUMNS; c++) {
+                header.offsets[c] = (file_size + 63) / 64 * 64;
+                file_size = header.offsets[c] + header.sizes[c];
+            }
+
+            OutputMapping output(path + ".tmp", file_size);
+            *output.at<Header>(0) = header;
+
+            // The time column and the strip indices follow from the first pass
+            auto out_time0 = output.at<double>(header.offsets[TIME0]);
+            auto out_index0 = output.at<uint64_t>(header.offsets[INDEX0]);
+            auto out_index1 = output.at<uint64_t>(header.offsets[INDEX1]);
+            out_index0[0] = 0;
+            out_index1[0] = 0;
+            for(size_t i = 0; i < entries; i++) {
+                out_time0[i] = times[order[i]];
+                out_index0[i + 1] = out_index0[i] + counts0[order[i]];
+                out_index1[i + 1] = out_index1[i] + counts1[order[i]];
+            }
+
+            // Sorted place of every entry of the tree, replacing the buffers of the first pass
+            std::vector<uint64_t> place(entries);
+            for(size_t i = 0; i < entries; i++) {
+                place[order[i]] = i;
+            }
+            std::vector<double>().swap(times);
+            std::vector<uint32_t>().swap(counts0);
+            std::vector<uint32_t>().swap(counts1);
+            std::vector<uint64_t>().swap(order);
+
+            // Second pass, every cluster is stored at its place in all columns
+            TTreeReader reader("clusters_detector", file.get());
+            TTreeReaderValue<unsigned char> det(reader, "det");
+            TTreeReaderValue<double> pos0(reader, "pos0");
+            TTreeReaderValue<double> pos1(reader, "pos1");
+            TTreeReaderValue<double> pos0_charge2(reader, "pos0_charge2");
+            TTreeReaderValue<double> pos1_charge2(reader, "pos1_charge2");
+            TTreeReaderValue<uint16_t> adc0(reader, "adc0");
+            TTreeReaderValue<uint16_t> adc1(reader, "adc1");
+            TTreeReaderValue<uint16_t> size0(reader, "size0");
+            TTreeReaderValue<uint16_t> size1(reader, "size1");
+            TTreeReaderArray<double> strips0(reader, "strips0");
+            TTreeReaderArray<double> adcs0(reader, "adcs0");
+            TTreeReaderArray<double> strips1(reader, "strips1");
+            TTreeReaderArray<double> adcs1(reader, "adcs1");
+
+            auto out_det = output.at<unsigned char>(header.offsets[DET]);
+            auto out_pos0 = output.at<double>(header.offsets[POS0]);
+            auto out_pos1 = output.at<double>(header.offsets[POS1]);
+            auto out_pos0_charge2 = output.at<double>(header.offsets[POS0_CHARGE2]);
+            auto out_pos1_charge2 = output.at<double>(header.offsets[POS1_CHARGE2]);
+            auto out_adc0 = output.at<uint16_t>(header.offsets[ADC0]);
+            auto out_adc1 = output.at<uint16_t>(header.offsets[ADC1]);
+            auto out_size0 = output.at<uint16_t>(header.offsets[SIZE0]);
+            auto out_size1 = output.at<uint16_t>(header.offsets[SIZE1]);
+            auto out_strips0 = output.at<double>(header.offsets[STRIPS0]);
+            auto out_adcs0 = output.at<double>(header.offsets[ADCS0]);
+            auto out_strips1 = output.at<double>(header.offsets[STRIPS1]);
+            auto out_adcs1 = output.at<double>(header.offsets[ADCS1]);
+
+            auto copy_strips = [](TTreeReaderArray<double>& strips,
+                                  TTreeReaderArray<double>& adcs,
+                                  const uint64_t* index,
+                                  uint64_t i,
+                                  double* out_strips,
+                                  double* out_adcs) {
+                if(strips.GetSize() != index[i + 1] - index[i]) {
+                    throw ModuleError("The clusters_detector tree changed while converting it into the column cache");
+                }
+                for(size_t s = 0; s < strips.GetSize(); s++) {
+                    out_strips[index[i] + s] = strips.At(s);
+                    out_adcs[index[i] + s] = s < adcs.GetSize() ? adcs.At(s) : 0;
+                }
+            };
+
+            size_t entry = 0;
+            while(reader.Next()) {
+                if(entry >= entries) {
+                    throw ModuleError("The clusters_detector tree changed while converting it into the column cache");
+                }
+                auto i = place[entry++];
+                out_det[i] = *det;
+                out_pos0[i] = *pos0;
+                out_pos1[i] = *pos1;
+                out_pos0_charge2[i] = *pos0_charge2;
+                out_pos1_charge2[i] = *pos1_charge2;
+                out_adc0[i] = *adc0;
+                out_adc1[i] = *adc1;
+                out_size0[i] = *size0;
+                out_size1[i] = *size1;
+                copy_strips(strips0, adcs0, out_index0, i, out_strips0, out_adcs0);
+                copy_strips(strips1, adcs1, out_index1, i, out_strips1, out_adcs1);
+            }
+            if(entry != entries || !output.commit(path)) {
+                throw ModuleError("Cannot write the column cache " + path);
+            }
+        }
+
+        MappedFile m_file;
+        size_t m_entries{0};
+        const unsigned char* m_det{nullptr};
+        const double* m_time0{nullptr};
+        const double* m_pos0{nullptr};
+        const double* m_pos1{nullptr};
+        const double* m_pos0Charge2{nullptr};
+        const double* m_pos1Charge2{nullptr};
+        const uint16_t* m_adc0{nullptr};
+        const uint16_t* m_adc1{nullptr};
+        const uint16_t* m_size0{nullptr};
+        const uint16_t* m_size1{nullptr};
+        const uint64_t* m_index0{nullptr};
+        const double* m_strips0{nullptr};
+        const double* m_adcs0{nullptr};
+        const uint64_t* m_index1{nullptr};
+        const double* m_strips1{nullptr};
+        const double* m_adcs1{nullptr};
+    };
+
+} // namespace corryvreckan
+#endif // CORRYVRECKAN_VMM3A_COLUMN_CACHE_H
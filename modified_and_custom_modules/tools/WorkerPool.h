@@ -0,0 +1,126 @@
+/**
+ * @file
+ * @brief Fixed pool of worker threads running the items of a batch in parallel
+ *
+ * @copyright Copyright (c) 2020 CERN and the Corryvreckan authors.
+ * This software is distributed under the terms of the MIT License, copied verbatim in the file "LICENSE.md".
+ * In applying this license, CERN does not waive the privileges and immunities granted to it by virtue of its status as an
+ * Intergovernmental Organization or submit itself to any jurisdiction.
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef CORRYVRECKAN_WORKER_POOL_H
+#define CORRYVRECKAN_WORKER_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace corryvreckan {
+    /**
+     * @brief Worker threads started once and reused for every batch
+     *
+     * forEach() hands out the items of a batch one by one to the workers and returns when all of them are done. Each
+     * call of the function gets the index of the worker running it, so per-thread state can be kept in an array
+     * indexed by worker without locking. The first exception thrown by an item is rethrown by forEach().
+     */
+    class WorkerPool {
+
+    public:
+        explicit WorkerPool(size_t threads) {
+            for(size_t worker = 0; worker < std::max<size_t>(threads, 1); worker++) {
+                m_threads.emplace_back([this, worker]() { work(worker); });
+            }
+        }
+
+        ~WorkerPool() {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+            }
+            m_start.notify_all();
+            for(auto& thread : m_threads) {
+                thread.join();
+            }
+        }
+
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        size_t size() const { return m_threads.size(); }
+
+        /**
+         * @brief Call function(item, worker) for all items in [0, count) and wait for them
+         */
+        void forEach(size_t count, const std::function<void(size_t, size_t)>& function) {
+            if(count == 0) {
+                return;
+            }
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_function = &function;
+            m_count = count;
+            m_next = 0;
+            m_running = m_threads.size();
+            m_error = nullptr;
+            m_batch++;
+            m_start.notify_all();
+            m_done.wait(lock, [this]() { return m_running == 0; });
+            m_function = nullptr;
+            if(m_error) {
+                std::rethrow_exception(m_error);
+            }
+        }
+
+    private:
+        void work(size_t worker) {
+            unsigned long batch = 0;
+            while(true) {
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_start.wait(lock, [this, batch]() { return m_stop || m_batch != batch; });
+                    if(m_stop) {
+                        return;
+                    }
+                    batch = m_batch;
+                }
+
+                for(size_t item = m_next++; item < m_count; item = m_next++) {
+                    try {
+                        (*m_function)(item, worker);
+                    } catch(...) {
+                        std::lock_guard<std::mutex> lock(m_mutex);
+                        if(!m_error) {
+                            m_error = std::current_exception();
+                        }
+                    }
+                }
+
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if(--m_running == 0) {
+                    m_done.notify_one();
+                }
+            }
+        }
+
+        std::vector<std::thread> m_threads;
+        std::mutex m_mutex;
+        std::condition_variable m_start;
+        std::condition_variable m_done;
+
+        // Current batch, the workers pick up a new one when m_batch changes
+        const std::function<void(size_t, size_t)>* m_function{nullptr};
+        size_t m_count{0};
+        std::atomic<size_t> m_next{0};
+        size_t m_running{0};
+        unsigned long m_batch{0};
+        bool m_stop{false};
+        std::exception_ptr m_error;
+    };
+
+} // namespace corryvreckan
+#endif // CORRYVRECKAN_WORKER_POOL_H